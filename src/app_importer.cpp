@@ -0,0 +1,313 @@
+#include "app_importer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compat-filesystem.h"
+#include "debug.h"
+
+namespace {
+
+constexpr char kDefaultSection[] = "applications";
+
+std::string Trim(const std::string &s) {
+	const std::string::size_type first = s.find_first_not_of(" \t\r\n");
+	if (first == std::string::npos) return std::string();
+	const std::string::size_type last = s.find_last_not_of(" \t\r\n");
+	return s.substr(first, last - first + 1);
+}
+
+bool EndsWith(const std::string &s, const char *suffix) {
+	const std::size_t length = strlen(suffix);
+	return s.size() > length && s.compare(s.size() - length, length, suffix) == 0;
+}
+
+// Makes `name` usable as a single file name: it must neither reach into
+// another directory nor be hidden.
+std::string FileName(std::string name) {
+	std::replace(name.begin(), name.end(), '/', '_');
+	if (!name.empty() && name[0] == '.') name[0] = '_';
+	return name;
+}
+
+bool IsExecutable(const std::string &path) {
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+	       (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH));
+}
+
+bool IsFile(const std::string &path) {
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Returns the value of the "exec" key of a link file, or an empty string.
+std::string LinkTarget(const std::string &path) {
+	std::ifstream in(path);
+	std::string line;
+	while (std::getline(in, line)) {
+		const std::string::size_type pos = line.find('=');
+		if (pos != std::string::npos && Trim(line.substr(0, pos)) == "exec")
+			return Trim(line.substr(pos + 1));
+	}
+	return std::string();
+}
+
+// Looks for a manual next to an executable, like links added by hand do.
+std::string FindManual(const std::string &stem) {
+	for (const char *ext : {".man.png", ".man.txt"}) {
+		if (IsFile(stem + ext)) return stem + ext;
+	}
+	return std::string();
+}
+
+// Reads the [Desktop Entry] group of a .desktop file into `app`. Returns
+// false if it has no Exec key.
+bool ParseDesktopFile(const std::string &dir, const std::string &path,
+                      AppImporter::App *app) {
+	std::ifstream in(path);
+	std::string line;
+	bool in_entry = false;
+	while (std::getline(in, line)) {
+		line = Trim(line);
+		if (line.empty() || line[0] == '#') continue;
+		if (line[0] == '[') {
+			in_entry = line == "[Desktop Entry]";
+			continue;
+		}
+		const std::string::size_type pos = line.find('=');
+		if (!in_entry || pos == std::string::npos) continue;
+		const std::string key = Trim(line.substr(0, pos));
+		const std::string value = Trim(line.substr(pos + 1));
+		if (key == "Name") {
+			app->title = value;
+		} else if (key == "Comment") {
+			app->description = value;
+		} else if (key == "Categories") {
+			// The section is a directory of its own in the sections directory.
+			app->section = FileName(Trim(value.substr(0, value.find(';'))));
+		} else if (key == "Terminal") {
+			app->console_app = value == "true";
+		} else if (key == "X-OD-Manual") {
+			app->manual = value[0] == '/' ? value : dir + "/" + value;
+		} else if (key == "Icon") {
+			app->icon = value;
+		} else if (key == "Exec") {
+			// The first word is the executable; field codes such as %f are
+			// filled in by launchers that pass files, which links don't.
+			std::istringstream words(value);
+			std::string word;
+			words >> app->exec;
+			while (words >> word) {
+				if (word[0] == '%') continue;
+				if (!app->params.empty()) app->params += ' ';
+				app->params += word;
+			}
+		}
+	}
+	if (app->exec.empty()) return false;
+	if (app->exec[0] != '/') app->exec = dir + "/" + app->exec;
+
+	// An icon is either a path or the name of a PNG next to the file.
+	if (!app->icon.empty() && app->icon[0] != '/') {
+		std::string icon = dir + "/" + app->icon;
+		if (!EndsWith(icon, ".png")) icon += ".png";
+		app->icon = IsFile(icon) ? icon : std::string();
+	}
+	return true;
+}
+
+// Returns a file name for a link with the given title in `dir` that is not
+// taken on disk or by `taken`.
+std::string UniqueName(const std::string &dir, const std::string &title,
+                       std::unordered_set<std::string> *taken) {
+	const std::string base = FileName(title.empty() ? "app" : title);
+	std::string name = base;
+	for (unsigned int i = 2;
+	     taken->count(name) || access((dir + "/" + name).c_str(), F_OK) == 0;
+	     ++i) {
+		name = base + std::to_string(i);
+	}
+	taken->insert(name);
+	return name;
+}
+
+std::string Serialize(const AppImporter::App &app) {
+	std::ostringstream out;
+	out << "title=" << app.title << '\n';
+	if (!app.description.empty()) out << "description=" << app.description << '\n';
+	if (!app.icon.empty()) out << "icon=" << app.icon << '\n';
+	out << "exec=" << app.exec << '\n';
+	if (!app.params.empty()) out << "params=" << app.params << '\n';
+	if (!app.manual.empty()) out << "manual=" << app.manual << '\n';
+	if (app.console_app) out << "consoleapp=true\n";
+	return out.str();
+}
+
+// Creates `path`, which must not exist yet, without syncing it.
+bool WriteNewFile(const std::string &path, const std::string &data) {
+	const int fd =
+	    open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0644);
+	if (fd < 0) return false;
+	const char *bytes = data.data();
+	std::size_t remaining = data.size();
+	bool ok = true;
+	while (ok && remaining != 0) {
+		const ssize_t written = write(fd, bytes, remaining);
+		ok = written > 0;
+		if (ok) {
+			bytes += written;
+			remaining -= written;
+		}
+	}
+	ok &= close(fd) == 0;
+	return ok;
+}
+
+}  // namespace
+
+AppImporter::AppImporter(std::string sections_dir,
+                         const std::vector<std::string> &other_sections_dirs)
+    : sections_dir_(std::move(sections_dir)) {
+	ReadLinks(sections_dir_);
+	for (const std::string &dir : other_sections_dirs) ReadLinks(dir);
+}
+
+void AppImporter::ReadLinks(const std::string &sections_dir) {
+	DIR *sections = opendir(sections_dir.c_str());
+	if (!sections) return;
+	while (struct dirent *section = readdir(sections)) {
+		if (section->d_name[0] == '.') continue;
+		const std::string dir = sections_dir + "/" + section->d_name;
+		DIR *links = opendir(dir.c_str());
+		if (!links) continue;
+		while (struct dirent *link = readdir(links)) {
+			if (link->d_name[0] == '.') continue;
+			const std::string target = LinkTarget(dir + "/" + link->d_name);
+			if (!target.empty()) linked_.insert(target);
+		}
+		closedir(links);
+	}
+	closedir(sections);
+}
+
+bool AppImporter::Scan(const std::string &path) {
+	// Links must point to absolute paths, which is also what they are
+	// compared by with existing links.
+	char *resolved = realpath(path.c_str(), nullptr);
+	DIR *dirp = resolved ? opendir(resolved) : nullptr;
+	if (!dirp) {
+		ERROR("Unable to scan '%s' for applications: %s\n", path.c_str(),
+		      strerror(errno));
+		free(resolved);
+		return false;
+	}
+	const std::string dir = resolved;
+	free(resolved);
+
+	std::vector<std::string> names;
+	while (struct dirent *dent = readdir(dirp)) {
+		if (dent->d_name[0] != '.') names.push_back(dent->d_name);
+	}
+	closedir(dirp);
+	std::sort(names.begin(), names.end());
+
+	auto add = [this](App &&app) {
+		if (!IsExecutable(app.exec) || linked_.count(app.exec)) return;
+		if (app.section.empty()) app.section = kDefaultSection;
+		linked_.insert(app.exec);
+		DEBUG("Found application '%s'\n", app.exec.c_str());
+		apps_.push_back(std::move(app));
+	};
+
+	// Metadata comes first, so that it wins over an icon of the same name.
+	for (const std::string &name : names) {
+		if (!EndsWith(name, ".desktop")) continue;
+		App app;
+		if (!ParseDesktopFile(dir, dir + "/" + name, &app)) continue;
+		if (app.title.empty())
+			app.title = name.substr(0, name.size() - strlen(".desktop"));
+		if (app.manual.empty()) {
+			app.manual = FindManual(app.exec.substr(0, app.exec.rfind('.')));
+		}
+		add(std::move(app));
+	}
+
+	for (const std::string &name : names) {
+		const std::string stem = dir + "/" + name.substr(0, name.rfind('.'));
+		if (EndsWith(name, ".desktop") || !IsFile(stem + ".png")) continue;
+		App app;
+		app.title = name.substr(0, name.rfind('.'));
+		app.exec = dir + "/" + name;
+		app.icon = stem + ".png";
+		app.manual = FindManual(stem);
+		add(std::move(app));
+	}
+	return true;
+}
+
+bool AppImporter::Write() {
+	std::map<std::string, std::vector<App *>> sections;
+	for (App &app : apps_) {
+		if (app.file.empty()) sections[app.section].push_back(&app);
+	}
+	bool ok = true;
+	for (auto &section : sections) {
+		ok &= WriteSection(section.first, &section.second);
+	}
+	return ok;
+}
+
+bool AppImporter::WriteSection(const std::string &section,
+                               std::vector<App *> *apps) {
+	const std::string dir = sections_dir_ + "/" + section;
+	std::error_code ec;
+	compat::filesystem::create_directories(dir, ec);
+
+	std::unordered_set<std::string> taken;
+	std::vector<std::string> written;
+	bool ok = true;
+	for (App *app : *apps) {
+		const std::string file = dir + "/" + UniqueName(dir, app->title, &taken);
+		if (!WriteNewFile(file, Serialize(*app))) {
+			ERROR("Unable to write link '%s': %s\n", file.c_str(),
+			      strerror(errno));
+			ok = false;
+			break;
+		}
+		written.push_back(file);
+	}
+
+	// A single sync of the file system commits the new files and the
+	// directory entries that point to them.
+	const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (ok && (fd < 0 || syncfs(fd) != 0)) {
+		ERROR("Unable to sync section '%s': %s\n", dir.c_str(),
+		      strerror(errno));
+		ok = false;
+	}
+	if (fd >= 0) close(fd);
+
+	if (!ok) {
+		for (const std::string &file : written) unlink(file.c_str());
+		return false;
+	}
+	for (std::size_t i = 0; i < written.size(); ++i) {
+		(*apps)[i]->file = written[i];
+	}
+	INFO("Imported %zu applications into section '%s'\n", written.size(),
+	     section.c_str());
+	return true;
+}
@@ -0,0 +1,62 @@
+#ifndef _APP_IMPORTER_H_
+#define _APP_IMPORTER_H_
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Finds applications in directories of executables and creates links to
+// them in bulk.
+//
+// An executable is imported if a ".desktop" file in its directory names it
+// in its Exec key, or if an icon with the same name and the extension
+// ".png" is next to it. Executables that a link already points to are
+// skipped, so importing a directory again only adds what is new.
+//
+// Does not depend on the rest of gmenu2x, so that it can also be used by a
+// command line tool.
+class AppImporter {
+ public:
+	struct App {
+		std::string section;
+		std::string title;
+		std::string description;
+		std::string exec;
+		std::string params;
+		std::string icon;
+		std::string manual;
+		bool console_app = false;
+		// The link file, once it is written.
+		std::string file;
+	};
+
+	// Links are written to the section directories in `sections_dir`, such
+	// as ~/.gmenu2x/sections. Applications that a link in it or in one of
+	// `other_sections_dirs` points to are skipped.
+	explicit AppImporter(std::string sections_dir,
+	                     const std::vector<std::string> &other_sections_dirs = {});
+
+	// Adds the applications found in `dir` that are not linked to yet.
+	// Returns false if the directory cannot be read.
+	bool Scan(const std::string &dir);
+
+	const std::vector<App> &apps() const { return apps_; }
+
+	// Writes a link for every application found. All links of a section are
+	// written first and then synced to disk once, instead of once per link.
+	// If a link of a section cannot be written, none of that section are
+	// kept. Returns false if any section failed.
+	bool Write();
+
+ private:
+	// Adds the targets of the links in `sections_dir` to `linked_`.
+	void ReadLinks(const std::string &sections_dir);
+	bool WriteSection(const std::string &section, std::vector<App *> *apps);
+
+	const std::string sections_dir_;
+	// The executables that have a link, by path.
+	std::unordered_set<std::string> linked_;
+	std::vector<App> apps_;
+};
+
+#endif  // _APP_IMPORTER_H_
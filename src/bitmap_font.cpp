@@ -0,0 +1,357 @@
+#include "bitmap_font.h"
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+
+struct BitmapFont::Header {
+	char magic[4];
+	std::uint16_t version;
+	std::uint16_t flags;
+	std::uint32_t byte_order;
+	std::uint32_t point_size;
+	// Size of the source font file, to detect a stale bitmap font.
+	std::uint64_t source_size;
+	std::int32_t line_spacing;
+	std::int32_t height;
+	std::uint32_t num_glyphs;
+	std::uint32_t pixels_size;
+};
+
+namespace {
+
+constexpr char kMagic[4] = {'G', '2', 'X', 'F'};
+constexpr std::uint16_t kVersion = 1;
+constexpr std::uint32_t kByteOrder = 0x01020304;
+
+constexpr std::size_t kCoverageWords = BitmapFont::kNumCodePoints / 64;
+constexpr std::size_t kRankEntries = BitmapFont::kNumCodePoints / 256;
+
+static_assert(sizeof(BitmapFont::Glyph) == 16, "Glyph must be packed");
+static_assert(sizeof(BitmapFont::Glyph) % 8 == 0 &&
+                  kRankEntries * sizeof(std::uint32_t) % 8 == 0,
+              "sections must stay 8-byte aligned");
+
+std::size_t TablesSize(std::size_t num_glyphs) {
+	return kCoverageWords * sizeof(std::uint64_t) +
+	       kRankEntries * sizeof(std::uint32_t) +
+	       num_glyphs * sizeof(BitmapFont::Glyph);
+}
+
+// Returns the size of the file at `path`, or -1 if it cannot be stat'ed.
+long long FileSize(const std::string &path) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return -1;
+	return st.st_size;
+}
+
+// Outlines an 8-bit coverage bitmap the same way FontStack::render does.
+// The result is 1 pixel larger on every side and stores (fill, outline)
+// pairs.
+std::vector<std::uint8_t> Outline(const SDL_Surface *s) {
+	const int w = s->w + 2, h = s->h + 2;
+	auto at = [s](int row, int col) -> std::uint8_t {
+		if (row < 0 || col < 0 || row >= s->h || col >= s->w) return 0;
+		return static_cast<const std::uint8_t *>(s->pixels)[row * s->pitch + col];
+	};
+	std::vector<std::uint8_t> result(w * h * 2);
+	for (int row = 0; row < h; ++row) {
+		for (int col = 0; col < w; ++col) {
+			const std::uint8_t center = at(row - 1, col - 1);
+			const std::uint8_t outline = std::max(
+			    {center, at(row - 2, col - 1), at(row, col - 1),
+			     at(row - 1, col), at(row - 1, col - 2)});
+			result[(row * w + col) * 2] = center;
+			result[(row * w + col) * 2 + 1] = outline;
+		}
+	}
+	return result;
+}
+
+// Calls `fn(x, y, fill, outline)` for every stored pixel of `text`, with x and
+// y relative to the start of the line. Returns the width of the line.
+template <typename F>
+int ForEachPixel(const BitmapFont &font, const std::uint16_t *text, F fn) {
+	int pen = 0;
+	for (; *text != 0; ++text) {
+		const BitmapFont::Glyph *glyph = font.GetGlyph(*text);
+		if (glyph == nullptr) continue;
+		const std::uint8_t *p = font.GetPixels(*glyph);
+		for (int row = 0; row < glyph->h; ++row) {
+			for (int col = 0; col < glyph->w; ++col, p += 2)
+				fn(pen + glyph->x + col, glyph->y + row, p[0], p[1]);
+		}
+		pen += glyph->advance;
+	}
+	return pen;
+}
+
+}  // namespace
+
+std::string BitmapFont::PathFor(const FontSpec &spec) {
+	return spec.path + "." + std::to_string(spec.size) + ".bfont";
+}
+
+BitmapFont::BitmapFont(void *map, std::size_t map_size)
+    : map_(map), map_size_(map_size) {
+	static_assert(sizeof(Header) % 8 == 0, "sections must stay 8-byte aligned");
+	const auto *base = static_cast<const std::uint8_t *>(map);
+	header_ = reinterpret_cast<const Header *>(base);
+	coverage_ = reinterpret_cast<const std::uint64_t *>(base + sizeof(Header));
+	rank_ = reinterpret_cast<const std::uint32_t *>(coverage_ + kCoverageWords);
+	glyphs_ = reinterpret_cast<const Glyph *>(rank_ + kRankEntries);
+	pixels_ = base + sizeof(Header) + TablesSize(header_->num_glyphs);
+}
+
+BitmapFont::~BitmapFont() { munmap(map_, map_size_); }
+
+std::unique_ptr<BitmapFont> BitmapFont::Open(const FontSpec &spec) {
+	const std::string path = PathFor(spec);
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return nullptr;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 ||
+	    static_cast<std::size_t>(st.st_size) < sizeof(Header) + TablesSize(0)) {
+		WARNING("Ignoring truncated bitmap font '%s'\n", path.c_str());
+		close(fd);
+		return nullptr;
+	}
+	void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		WARNING("Unable to map bitmap font '%s': %s\n", path.c_str(),
+		        strerror(errno));
+		return nullptr;
+	}
+	std::unique_ptr<BitmapFont> font(new BitmapFont(map, st.st_size));
+
+	const Header &header = *font->header_;
+	if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+	    header.version != kVersion || header.byte_order != kByteOrder ||
+	    st.st_size != static_cast<off_t>(sizeof(Header) +
+	                                     TablesSize(header.num_glyphs) +
+	                                     header.pixels_size)) {
+		WARNING("Ignoring invalid bitmap font '%s'\n", path.c_str());
+		return nullptr;
+	}
+
+	// The source font may be left out of a skin on purpose, so only reject
+	// the bitmap font if the source font exists and differs.
+	const long long source_size = FileSize(spec.path);
+	if (header.point_size != spec.size ||
+	    (source_size >= 0 &&
+	     static_cast<std::uint64_t>(source_size) != header.source_size)) {
+		WARNING("Ignoring stale bitmap font '%s'\n", path.c_str());
+		return nullptr;
+	}
+
+	return font;
+}
+
+const BitmapFont::Glyph *BitmapFont::GetGlyph(std::uint16_t code_point) const {
+	if (!HasGlyph(code_point)) return nullptr;
+	std::uint32_t index = rank_[code_point >> 8];
+	for (std::size_t word = (code_point >> 8) * 4; word < (code_point >> 6u);
+	     ++word) {
+		index += __builtin_popcountll(coverage_[word]);
+	}
+	const std::uint64_t below =
+	    (std::uint64_t{1} << (code_point & 63)) - 1;
+	index += __builtin_popcountll(coverage_[code_point >> 6] & below);
+
+	if (index >= header_->num_glyphs) return nullptr;
+	const Glyph &glyph = glyphs_[index];
+	if (glyph.offset + std::size_t{glyph.w} * glyph.h * 2 > header_->pixels_size)
+		return nullptr;
+	return &glyph;
+}
+
+int BitmapFont::getLineSpacing() const { return header_->line_spacing; }
+
+int BitmapFont::getHeight() const { return header_->height; }
+
+bool BitmapFont::isComplete() const {
+	return header_->flags & kFlagComplete;
+}
+
+int BitmapFont::getTextWidth(const std::uint16_t *text) const {
+	int width = 0;
+	for (; *text != 0; ++text) {
+		const Glyph *glyph = GetGlyph(*text);
+		if (glyph != nullptr) width += glyph->advance;
+	}
+	return width;
+}
+
+SDL_Surface *BitmapFont::RenderShaded(const std::uint16_t *text) const {
+	const int width = getTextWidth(text);
+	if (width <= 0) return nullptr;
+	SDL_Surface *s =
+	    SDL_CreateRGBSurface(SDL_SWSURFACE, width, getHeight(), 8, 0, 0, 0, 0);
+	if (s == nullptr) return nullptr;
+	ForEachPixel(*this, text, [s](int x, int y, std::uint8_t fill, std::uint8_t) {
+		if (x < 0 || y < 0 || x >= s->w || y >= s->h) return;
+		auto &pixel = static_cast<std::uint8_t *>(s->pixels)[y * s->pitch + x];
+		pixel = std::max(pixel, fill);
+	});
+	return s;
+}
+
+SDL_Surface *BitmapFont::RenderOutlined(const std::uint16_t *text) const {
+	const int width = getTextWidth(text);
+	if (width <= 0) return nullptr;
+	SDL_Surface *s =
+	    SDL_CreateRGBSurface(SDL_SWSURFACE | SDL_SRCALPHA, width + 2,
+	                         getHeight() + 2, 32,
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+	                         0xff << 8, 0xff << 16, 0xff << 24, 0xff
+#else
+	                         0xff << 16, 0xff << 8, 0xff, 0xff << 24
+#endif
+	    );
+	if (s == nullptr) return nullptr;
+	const SDL_PixelFormat *fmt = s->format;
+	ForEachPixel(*this, text, [s, fmt](int x, int y, std::uint8_t fill,
+	                                   std::uint8_t outline) {
+		++x, ++y;
+		if (x < 0 || y < 0 || x >= s->w || y >= s->h) return;
+		auto &pixel = reinterpret_cast<std::uint32_t *>(
+		    static_cast<std::uint8_t *>(s->pixels) + y * s->pitch)[x];
+		// Overlapping glyphs are merged by taking the maximum of both.
+		const std::uint32_t old_fill = (pixel & fmt->Rmask) >> fmt->Rshift;
+		const std::uint32_t old_outline = (pixel & fmt->Amask) >> fmt->Ashift;
+		const std::uint32_t c = std::max<std::uint32_t>(fill, old_fill);
+		const std::uint32_t a = std::max<std::uint32_t>(outline, old_outline);
+		pixel = (c << fmt->Rshift) | (c << fmt->Gshift) | (c << fmt->Bshift) |
+		        (a << fmt->Ashift);
+	});
+	return s;
+}
+
+bool BitmapFont::Compile(
+    const FontSpec &spec, const std::string &out_path,
+    const std::vector<std::pair<std::uint16_t, std::uint16_t>> &ranges) {
+	const long long source_size = FileSize(spec.path);
+	if (source_size < 0) {
+		ERROR("Unable to stat font '%s'\n", spec.path.c_str());
+		return false;
+	}
+	if (TTF_Init() < 0) {
+		ERROR("Unable to init SDL_ttf library\n");
+		return false;
+	}
+	TTF_Font *font = TTF_OpenFont(spec.path.c_str(), spec.size);
+	if (font == nullptr) {
+		ERROR("Unable to open font '%s'\n", spec.path.c_str());
+		TTF_Quit();
+		return false;
+	}
+
+	Header header = {};
+	std::memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.flags = ranges.empty() ? kFlagComplete : 0;
+	header.byte_order = kByteOrder;
+	header.point_size = spec.size;
+	header.source_size = source_size;
+	header.line_spacing = TTF_FontLineSkip(font);
+	header.height = TTF_FontHeight(font);
+
+	std::vector<std::uint64_t> coverage(kCoverageWords);
+	std::vector<std::uint32_t> rank(kRankEntries);
+	std::vector<Glyph> glyphs;
+	std::vector<std::uint8_t> pixels;
+
+	auto wanted = [&ranges](std::uint16_t cp) {
+		if (ranges.empty()) return true;
+		for (const auto &range : ranges)
+			if (cp >= range.first && cp <= range.second) return true;
+		return false;
+	};
+
+	for (std::size_t cp = 1; cp < kNumCodePoints; ++cp) {
+		if ((cp & 0xFF) == 0) rank[cp >> 8] = glyphs.size();
+		if (!wanted(cp) || !TTF_GlyphIsProvided(font, cp)) continue;
+
+		int minx, maxx, miny, maxy, advance;
+		if (TTF_GlyphMetrics(font, cp, &minx, &maxx, &miny, &maxy, &advance) < 0)
+			continue;
+
+		Glyph glyph = {};
+		glyph.advance = advance;
+		glyph.offset = pixels.size();
+
+		const std::uint16_t text[2] = {static_cast<std::uint16_t>(cp), 0};
+		SDL_Surface *s =
+		    TTF_RenderUNICODE_Shaded(font, text, SDL_Color{}, SDL_Color{});
+		if (s != nullptr) {
+			const std::vector<std::uint8_t> outlined = Outline(s);
+			const int w = s->w + 2, h = s->h + 2;
+			SDL_FreeSurface(s);
+
+			// Crop to the pixels the outline touches.
+			int x0 = w, y0 = h, x1 = -1, y1 = -1;
+			for (int row = 0; row < h; ++row) {
+				for (int col = 0; col < w; ++col) {
+					if (outlined[(row * w + col) * 2 + 1] == 0) continue;
+					x0 = std::min(x0, col);
+					x1 = std::max(x1, col);
+					y0 = std::min(y0, row);
+					y1 = std::max(y1, row);
+				}
+			}
+			if (x1 >= 0) {
+				glyph.x = std::min(0, minx) - 1 + x0;
+				glyph.y = y0 - 1;
+				glyph.w = x1 - x0 + 1;
+				glyph.h = y1 - y0 + 1;
+				for (int row = y0; row <= y1; ++row) {
+					const auto *line = &outlined[(row * w + x0) * 2];
+					pixels.insert(pixels.end(), line, line + glyph.w * 2);
+				}
+			}
+		}
+
+		coverage[cp >> 6] |= std::uint64_t{1} << (cp & 63);
+		glyphs.push_back(glyph);
+	}
+
+	TTF_CloseFont(font);
+	TTF_Quit();
+
+	header.num_glyphs = glyphs.size();
+	header.pixels_size = pixels.size();
+
+	const std::string temp_path = out_path + '~';
+	std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(coverage.data()),
+	          coverage.size() * sizeof(coverage[0]));
+	out.write(reinterpret_cast<const char *>(rank.data()),
+	          rank.size() * sizeof(rank[0]));
+	out.write(reinterpret_cast<const char *>(glyphs.data()),
+	          glyphs.size() * sizeof(glyphs[0]));
+	out.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+	out.close();
+	if (out.fail() || std::rename(temp_path.c_str(), out_path.c_str()) != 0) {
+		ERROR("Unable to write bitmap font '%s'\n", out_path.c_str());
+		std::remove(temp_path.c_str());
+		return false;
+	}
+
+	INFO("Compiled %zu glyphs (%zu bytes of pixels) into '%s'\n", glyphs.size(),
+	     pixels.size(), out_path.c_str());
+	return true;
+}
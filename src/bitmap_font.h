@@ -0,0 +1,108 @@
+#ifndef _BITMAP_FONT_H_
+#define _BITMAP_FONT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "font_spec.h"
+
+struct SDL_Surface;
+
+// A font that has been rasterized ahead of time by `gmenu2x-mkfont`.
+//
+// The file is mapped into memory as-is: there is nothing to parse besides
+// validating the header, so loading it does not involve FreeType at all.
+//
+// Layout (native byte order, every section 8-byte aligned):
+//
+//   Header
+//   std::uint64_t coverage[kNumCodePoints / 64]  one bit per BMP code point
+//   std::uint32_t rank[kNumCodePoints / 256]     glyphs before each 256-block
+//   Glyph         glyphs[num_glyphs]             in code point order
+//   std::uint8_t  pixels[pixels_size]            (fill, outline) alpha pairs
+class BitmapFont {
+ public:
+	static constexpr std::size_t kNumCodePoints = 0x10000;
+
+	// Glyph bitmaps include a one pixel outline on every side.
+	struct Glyph {
+		std::int16_t advance;
+		// Position of the top-left of the bitmap relative to the pen
+		// position and the top of the line.
+		std::int16_t x, y;
+		std::uint16_t w, h;
+		std::uint16_t reserved;
+		std::uint32_t offset;  // into the pixels section
+	};
+
+	// Set if every glyph the source font provides is in the file, in which
+	// case the source font never has to be opened.
+	static constexpr std::uint16_t kFlagComplete = 1 << 0;
+
+	// Where the compiled form of the given font is looked for.
+	static std::string PathFor(const FontSpec &spec);
+
+	// Maps the compiled form of `spec`. Returns nullptr if there is none or
+	// if it is out of date.
+	static std::unique_ptr<BitmapFont> Open(const FontSpec &spec);
+
+	// Rasterizes the given font with SDL_ttf and writes the result to
+	// `out_path`. Only code points in `ranges` (inclusive) are included;
+	// an empty list means all code points the font provides.
+	// Returns `true` on success.
+	static bool Compile(
+	    const FontSpec &spec, const std::string &out_path,
+	    const std::vector<std::pair<std::uint16_t, std::uint16_t>> &ranges);
+
+	BitmapFont(const BitmapFont &) = delete;
+	BitmapFont &operator=(const BitmapFont &) = delete;
+	~BitmapFont();
+
+	bool HasGlyph(std::uint16_t code_point) const {
+		return (coverage_[code_point >> 6] >> (code_point & 63)) & 1;
+	}
+
+	// Returns nullptr if the glyph is not in the file.
+	const Glyph *GetGlyph(std::uint16_t code_point) const;
+
+	const std::uint8_t *GetPixels(const Glyph &glyph) const {
+		return pixels_ + glyph.offset;
+	}
+
+	int getLineSpacing() const;
+	int getHeight() const;
+	bool isComplete() const;
+
+	// Sum of the advances of `text`, which must be 0-terminated and only
+	// contain code points that are in the file.
+	int getTextWidth(const std::uint16_t *text) const;
+
+	// Renders `text` into an 8-bit coverage map, like
+	// TTF_RenderUNICODE_Shaded with a black palette does.
+	// Returns nullptr if there is nothing to draw.
+	SDL_Surface *RenderShaded(const std::uint16_t *text) const;
+
+	// Renders `text` in white with a black outline into a 32-bit surface
+	// with per-pixel alpha, one pixel larger than the text on every side.
+	// Returns nullptr if there is nothing to draw.
+	SDL_Surface *RenderOutlined(const std::uint16_t *text) const;
+
+ private:
+	struct Header;
+
+	BitmapFont(void *map, std::size_t map_size);
+
+	void *map_;
+	std::size_t map_size_;
+	const Header *header_;
+	const std::uint64_t *coverage_;
+	const std::uint32_t *rank_;
+	const Glyph *glyphs_;
+	const std::uint8_t *pixels_;
+};
+
+#endif  // _BITMAP_FONT_H_
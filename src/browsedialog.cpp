@@ -18,6 +18,7 @@ BrowseDialog::BrowseDialog(
 	: Dialog(gmenu2x)
 	, title(title)
 	, subtitle(subtitle)
+	, jumpBar(gmenu2x)
 {
 	buttonBox.add(unique_ptr<IconButton>(new IconButton(
 			gmenu2x, "skin:imgs/buttons/left.png")));
@@ -31,6 +32,11 @@ BrowseDialog::BrowseDialog(
 			gmenu2x.tr["Select"],
 			bind(&BrowseDialog::directoryEnter, this))));
 
+	buttonBox.add(unique_ptr<IconButton>(new IconButton(
+			gmenu2x, "skin:imgs/buttons/right.png",
+			gmenu2x.tr["Jump"],
+			bind(&BrowseDialog::jump, this))));
+
 	buttonBox.add(unique_ptr<IconButton>(new IconButton(
 			gmenu2x, "skin:imgs/buttons/start.png",
 			gmenu2x.tr["Confirm"],
@@ -98,6 +104,8 @@ BrowseDialog::Action BrowseDialog::getAction(InputManager::Button button)
 			return BrowseDialog::ACT_SELECT;
 		case InputManager::SETTINGS:
 			return BrowseDialog::ACT_CONFIRM;
+		case InputManager::RIGHT:
+			return BrowseDialog::ACT_JUMP;
 		default:
 			return BrowseDialog::ACT_NONE;
 	}
@@ -106,6 +114,10 @@ BrowseDialog::Action BrowseDialog::getAction(InputManager::Button button)
 void BrowseDialog::handleInput()
 {
 	InputManager::Button button = gmenu2x.input.waitForPressedButton();
+	if (jumpBar.is_open()) {
+		jumpBar.HandleButton(button, fl, &selected);
+		return;
+	}
 	BrowseDialog::Action action = getAction(button);
 
 	if (action == BrowseDialog::ACT_SELECT && fl[selected] == "..") {
@@ -142,6 +154,9 @@ void BrowseDialog::handleInput()
 	case BrowseDialog::ACT_GOUP:
 		directoryUp();
 		break;
+	case BrowseDialog::ACT_JUMP:
+		jump();
+		break;
 	case BrowseDialog::ACT_SELECT:
 		if (fl.isDirectory(selected)) {
 			directoryEnter();
@@ -186,11 +201,16 @@ void BrowseDialog::directoryEnter()
 		path += "/";
 	}
 
-	setPath(path + fl[selected]);
+	setPath(path + string(fl[selected]));
 
 	selected = 0;
 }
 
+void BrowseDialog::jump()
+{
+	jumpBar.Open(fl, &selected);
+}
+
 void BrowseDialog::confirm()
 {
 	result = true;
@@ -263,5 +283,6 @@ void BrowseDialog::paint()
 	s.clearClipRect();
 
 	gmenu2x.drawScrollBar(numRows,fl.size(), firstElement);
+	jumpBar.Paint(s);
 	s.flip();
 }
@@ -25,6 +25,7 @@
 #include "dialog.h"
 #include "filelister.h"
 #include "inputmanager.h"
+#include "jump_bar.h"
 
 #include <SDL.h>
 #include <string>
@@ -56,6 +57,7 @@ private:
 		ACT_SCROLLDOWN,
 		ACT_GOUP,
 		ACT_CONFIRM,
+		ACT_JUMP,
 	};
 
 	bool close, result;
@@ -74,6 +76,7 @@ private:
 	OffscreenSurface *iconFile;
 
 	ButtonBox buttonBox;
+	JumpBar jumpBar;
 
 	Action getAction(InputManager::Button button);
 	void handleInput();
@@ -82,6 +85,7 @@ private:
 
 	void directoryUp();
 	void directoryEnter();
+	void jump();
 	void confirm();
 	void quit();
 
@@ -92,7 +96,7 @@ public:
 		return path;
 	}
 	std::string getFile() {
-		return fl[selected];
+		return std::string(fl[selected]);
 	}
 };
 
@@ -0,0 +1,36 @@
+#include "collation.h"
+
+#include <algorithm>
+
+namespace {
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Longest number that is compared by value; longer ones are split.
+constexpr std::size_t kMaxDigits = 255;
+
+}  // namespace
+
+void AppendCollationKey(compat::string_view name, std::string *key) {
+	key->reserve(key->size() + name.size());
+	for (std::size_t i = 0; i < name.size();) {
+		if (!IsDigit(name[i])) {
+			key->push_back(FoldCase(name[i++]));
+			continue;
+		}
+
+		// A number becomes '0', its number of digits and its digits without
+		// leading zeros, so that shorter numbers come first. The '0' keeps
+		// numbers where digits are among the other characters.
+		while (i < name.size() && name[i] == '0') ++i;
+		std::size_t end = i;
+		while (end < name.size() && IsDigit(name[end])) ++end;
+		do {
+			const std::size_t length = std::min(end - i, kMaxDigits);
+			key->push_back('0');
+			key->push_back(static_cast<char>(length));
+			key->append(name.data() + i, length);
+			i += length;
+		} while (i < end);
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef _COLLATION_H_
+#define _COLLATION_H_
+
+#include <string>
+
+#include "compat-string_view.h"
+
+// Sort keys that order names the way people expect: ignoring the case of
+// ASCII letters, and with numbers by their value, so that "Level 9" comes
+// before "level 10". Keys are compared bytewise.
+//
+// Different names can have the same key, such as "a" and "A" or "7" and
+// "07"; those should be ordered by the names themselves.
+
+// Appends the sort key of `name` to `key`.
+void AppendCollationKey(compat::string_view name, std::string *key);
+
+inline std::string CollationKey(compat::string_view name) {
+	std::string key;
+	AppendCollationKey(name, &key);
+	return key;
+}
+
+inline char FoldCase(char c) {
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+#endif  // _COLLATION_H_
@@ -3,7 +3,7 @@
 #include "dialog.h"
 #include "gmenu2x.h"
 #include "font_stack.h"
-#include "word_wrap.h"
+#include "wrapped_text_cache.h"
 
 Dialog::Dialog(GMenu2X& gmenu2x) : gmenu2x(gmenu2x)
 {
@@ -27,14 +27,12 @@ void Dialog::drawTitleIcon(Surface& s, const std::string &icon, bool skinRes)
 
 void Dialog::writeTitle(Surface& s, const std::string &title)
 {
-	gmenu2x.font->write(s, title, 40, 0, Font::HAlignLeft, Font::VAlignTop);
+	gmenu2x.wrappedText.Get(*gmenu2x.font, title, 0).blit(s, 40, 0);
 }
 
 void Dialog::writeSubTitle(Surface& s, const std::string &subtitle)
 {
-	std::string wrapped = wordWrap(*gmenu2x.font, subtitle, gmenu2x.width() - 48);
-	gmenu2x.font->write(s, wrapped, 40,
-			gmenu2x.skinConfInt["topBarHeight"]
-				- gmenu2x.font->getTextHeight(wrapped),
-			Font::HAlignLeft, Font::VAlignTop);
+	const auto &layout = gmenu2x.wrappedText.Get(
+			*gmenu2x.font, subtitle, gmenu2x.width() - 48);
+	layout.blit(s, 40, gmenu2x.skinConfInt["topBarHeight"] - layout.height);
 }
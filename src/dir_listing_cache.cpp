@@ -0,0 +1,381 @@
+#include "dir_listing_cache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef ENABLE_INOTIFY
+#include <sys/inotify.h>
+#endif
+
+#include "debug.h"
+#include "library_index.h"
+#include "utilities.h"
+
+namespace {
+
+// Large ROM directories can take megabytes each, so keep only the most
+// recently used ones.
+constexpr std::size_t kMaxEntries = 16;
+
+// Number of entries a scan reads before handing them over.
+constexpr std::size_t kScanBatchSize = 64;
+
+// Minimum time between repaint requests of a scan.
+constexpr auto kScanRepaintInterval = std::chrono::milliseconds(100);
+
+std::string NormalizePath(const std::string &path) {
+	std::string result = path;
+	while (result.size() > 1 && result.back() == '/') result.pop_back();
+	return result;
+}
+
+bool SameStat(const struct stat &a, const struct stat &b) {
+	return a.st_mtim.tv_sec == b.st_mtim.tv_sec &&
+	       a.st_mtim.tv_nsec == b.st_mtim.tv_nsec && a.st_dev == b.st_dev &&
+	       a.st_ino == b.st_ino;
+}
+
+// Entry layout of the getdents64 system call.
+struct LinuxDirent64 {
+	std::uint64_t d_ino;
+	std::int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+// Size of the buffer that directory entries are read into in bulk.
+constexpr std::size_t kDirentBufferSize = 64 * 1024;
+
+// Calls `fn(name, is_dir)` for every directory and regular file in `path`,
+// until it returns false. Returns false with errno set if the directory
+// cannot be opened.
+//
+// Reads the entries with getdents64 into a large buffer rather than one at
+// a time through readdir, and only stats entries whose type the file
+// system does not report, relative to the directory.
+template <typename F>
+bool ForEachEntry(const std::string &path, F fn) {
+	const int dirfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd < 0) return false;
+
+	std::unique_ptr<char[]> buf(new char[kDirentBufferSize]);
+	for (;;) {
+		const long len = syscall(SYS_getdents64, dirfd, buf.get(),
+		                         kDirentBufferSize);
+		if (len < 0) {
+			ERROR("Unable to read directory '%s': %s\n", path.c_str(),
+			      strerror(errno));
+			break;
+		}
+		if (len == 0) break;
+
+		for (long pos = 0; pos < len;) {
+			const auto *dent =
+			    reinterpret_cast<const LinuxDirent64 *>(buf.get() + pos);
+			pos += dent->d_reclen;
+			const char *name = dent->d_name;
+
+			// Ignore hidden files and ".", but not "..".
+			if (name[0] == '.' && !(name[1] == '.' && name[2] == '\0')) continue;
+
+			bool is_dir, is_file;
+			if (dent->d_type != DT_UNKNOWN && dent->d_type != DT_LNK) {
+				is_dir = dent->d_type == DT_DIR;
+				is_file = dent->d_type == DT_REG;
+			} else {
+				struct stat st;
+				if (fstatat(dirfd, name, &st, 0) == -1) {
+					ERROR("Stat failed on '%s/%s' with error '%s'\n", path.c_str(),
+					      name, strerror(errno));
+					continue;
+				}
+				is_dir = S_ISDIR(st.st_mode);
+				is_file = S_ISREG(st.st_mode);
+			}
+
+			if ((is_dir || is_file) && !fn(name, is_dir)) {
+				close(dirfd);
+				return true;
+			}
+		}
+	}
+	close(dirfd);
+	return true;
+}
+
+void SortListing(DirListing *listing) {
+	listing->directories.Sort();
+	listing->files.Sort();
+	listing->directories.ShrinkToFit();
+	listing->files.ShrinkToFit();
+}
+
+void Append(NameList *from, NameList *to) {
+	if (to->empty()) {
+		std::swap(*from, *to);
+	} else {
+		to->Append(*from);
+	}
+	from->Clear();
+}
+
+}  // namespace
+
+bool ReadDirListing(const std::string &path, DirListing *listing) {
+	if (!ForEachEntry(path, [listing](const char *name, bool is_dir) {
+		    (is_dir ? listing->directories : listing->files).Add(name);
+		    return true;
+	    })) {
+		return false;
+	}
+	SortListing(listing);
+	return true;
+}
+
+DirScan::DirScan(std::string path) : path_(NormalizePath(path)) {
+	if (::stat(path_.c_str(), &stat_) != 0) {
+		error_ = errno;
+		done_ = true;
+		return;
+	}
+	thread_ = std::thread(&DirScan::Run, this);
+}
+
+DirScan::~DirScan() {
+	if (thread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			cancel_ = true;
+		}
+		thread_.join();
+	}
+}
+
+void DirScan::Run() {
+	auto listing = std::make_shared<DirListing>();
+	DirListing batch;
+	std::size_t batch_size = 0;
+	auto last_repaint = std::chrono::steady_clock::now();
+
+	auto flush = [&]() {
+		listing->directories.Append(batch.directories);
+		listing->files.Append(batch.files);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (cancel_) return false;
+			Append(&batch.directories, &pending_.directories);
+			Append(&batch.files, &pending_.files);
+			count_ += batch_size;
+		}
+		batch_size = 0;
+		cond_.notify_all();
+
+		const auto now = std::chrono::steady_clock::now();
+		if (now - last_repaint >= kScanRepaintInterval) {
+			last_repaint = now;
+			request_repaint();
+		}
+		return true;
+	};
+
+	const bool opened =
+	    ForEachEntry(path_, [&](const char *name, bool is_dir) {
+		    (is_dir ? batch.directories : batch.files).Add(name);
+		    return ++batch_size < kScanBatchSize || flush();
+	    });
+	const int error = opened ? 0 : errno;
+	if (!flush()) return;
+
+	SortListing(listing.get());
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		listing_ = std::move(listing);
+		error_ = error;
+		done_ = true;
+	}
+	cond_.notify_all();
+	request_repaint();
+}
+
+void DirScan::WaitFor(std::size_t count) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	cond_.wait(lock, [&]() { return done_ || count_ >= count; });
+}
+
+bool DirScan::Take(DirListing *chunk) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	Append(&pending_.directories, &chunk->directories);
+	Append(&pending_.files, &chunk->files);
+	return done_;
+}
+
+std::size_t DirScan::count() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return count_;
+}
+
+bool DirScan::ok() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	errno = error_;
+	return error_ == 0;
+}
+
+DirListingCache &DirListingCache::instance() {
+	static DirListingCache cache;
+	return cache;
+}
+
+DirListingCache::DirListingCache() {
+#ifdef ENABLE_INOTIFY
+	inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd_ < 0)
+		WARNING("Unable to start inotify for directory listings\n");
+#endif
+}
+
+DirListingCache::~DirListingCache() {
+	if (inotify_fd_ >= 0) close(inotify_fd_);
+}
+
+std::shared_ptr<const DirListing> DirListingCache::Get(
+    const std::string &path) {
+	if (auto listing = Find(path)) return listing;
+
+	const std::string key = NormalizePath(path);
+	struct stat st;
+	if (stat(key.c_str(), &st) != 0) return nullptr;
+
+	auto listing = std::make_shared<DirListing>();
+	if (!ReadDirListing(key, listing.get())) return nullptr;
+	Put(key, st, listing);
+	return listing;
+}
+
+std::shared_ptr<const DirListing> DirListingCache::Find(
+    const std::string &path) {
+	ProcessEvents();
+
+	const std::string key = NormalizePath(path);
+	struct stat st;
+	if (stat(key.c_str(), &st) != 0) {
+		Invalidate(key);
+		return nullptr;
+	}
+
+	auto it = entries_.find(key);
+	if (it != entries_.end()) {
+		Entry &entry = it->second;
+		if (SameStat(entry.st, st)) {
+			entry.last_used = ++clock_;
+			return entry.listing;
+		}
+		Erase(it);
+	}
+
+	auto listing = LibraryIndex::instance().Load(key, st);
+	if (!listing || !Insert(key, st, listing)) return nullptr;
+	return listing;
+}
+
+void DirListingCache::Put(const std::string &path, const struct stat &st,
+                          std::shared_ptr<const DirListing> listing) {
+	const std::string key = NormalizePath(path);
+	if (Insert(key, st, listing)) {
+		LibraryIndex::instance().Store(key, st, std::move(listing));
+	}
+}
+
+bool DirListingCache::Insert(const std::string &key, const struct stat &st,
+                             std::shared_ptr<const DirListing> listing) {
+	Invalidate(key);
+
+	int watch = -1;
+#ifdef ENABLE_INOTIFY
+	if (inotify_fd_ >= 0) {
+		watch = inotify_add_watch(inotify_fd_, key.c_str(),
+		                          IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+		                              IN_MOVED_TO | IN_DELETE_SELF |
+		                              IN_MOVE_SELF | IN_ONLYDIR);
+	}
+#endif
+
+	// Changes made while the directory was read were not watched yet, but
+	// they did change its modification time.
+	struct stat now;
+	if (stat(key.c_str(), &now) != 0 || !SameStat(st, now)) {
+#ifdef ENABLE_INOTIFY
+		bool shared = false;
+		for (const auto &entry : entries_)
+			shared |= entry.second.watch == watch;
+		if (watch >= 0 && !shared) inotify_rm_watch(inotify_fd_, watch);
+#endif
+		return false;
+	}
+
+	if (entries_.size() >= kMaxEntries) {
+		Erase(std::min_element(entries_.begin(), entries_.end(),
+		                       [](const std::pair<const std::string, Entry> &a,
+		                          const std::pair<const std::string, Entry> &b) {
+			                       return a.second.last_used < b.second.last_used;
+		                       }));
+	}
+	entries_[key] = Entry{std::move(listing), st, watch, ++clock_};
+	return true;
+}
+
+void DirListingCache::Invalidate(const std::string &path) {
+	auto it = entries_.find(NormalizePath(path));
+	if (it != entries_.end()) Erase(it);
+}
+
+void DirListingCache::Erase(
+    std::unordered_map<std::string, Entry>::iterator it) {
+#ifdef ENABLE_INOTIFY
+	const int watch = it->second.watch;
+	entries_.erase(it);
+	// Different paths to the same directory share a watch.
+	if (watch < 0) return;
+	for (const auto &entry : entries_)
+		if (entry.second.watch == watch) return;
+	inotify_rm_watch(inotify_fd_, watch);
+#else
+	entries_.erase(it);
+#endif
+}
+
+void DirListingCache::ProcessEvents() {
+#ifdef ENABLE_INOTIFY
+	if (inotify_fd_ < 0) return;
+	alignas(struct inotify_event) char buf[4096];
+	for (;;) {
+		const ssize_t len = read(inotify_fd_, buf, sizeof(buf));
+		if (len <= 0) break;
+		for (ssize_t i = 0; i < len;) {
+			const auto *event =
+			    reinterpret_cast<const struct inotify_event *>(buf + i);
+			i += sizeof(struct inotify_event) + event->len;
+			for (auto it = entries_.begin(); it != entries_.end();) {
+				if (it->second.watch != event->wd) {
+					++it;
+					continue;
+				}
+				// The kernel drops the watch by itself after IN_IGNORED.
+				if (event->mask & IN_IGNORED) it->second.watch = -1;
+				auto next = std::next(it);
+				Erase(it);
+				it = next;
+			}
+		}
+	}
+#endif
+}
@@ -0,0 +1,139 @@
+#ifndef _DIR_LISTING_CACHE_H_
+#define _DIR_LISTING_CACHE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+#include "name_list.h"
+
+// The sorted contents of a directory, without hidden entries except "..".
+struct DirListing {
+	NameList directories;
+	NameList files;  // regular files only
+};
+
+// Reads the given directory into a sorted listing. Returns false with errno
+// set if the directory cannot be opened.
+bool ReadDirListing(const std::string &path, DirListing *listing);
+
+// Reads a directory in a background thread, so that the entries can be
+// shown while a huge directory is still being read.
+class DirScan {
+ public:
+	// Starts reading the given directory.
+	explicit DirScan(std::string path);
+
+	DirScan(const DirScan &) = delete;
+	DirScan &operator=(const DirScan &) = delete;
+
+	// Stops reading if the scan is not complete yet.
+	~DirScan();
+
+	// Blocks until at least `count` entries have been read or the scan is
+	// complete.
+	void WaitFor(std::size_t count);
+
+	// Moves the entries read since the last call into `chunk`, unsorted.
+	// Returns true if the scan is complete and there are no entries left.
+	bool Take(DirListing *chunk);
+
+	// Number of entries read so far.
+	std::size_t count() const;
+
+	// Returns false with errno set if the directory could not be read.
+	bool ok() const;
+
+	// The sorted listing, once Take() has returned true.
+	const std::shared_ptr<const DirListing> &listing() const {
+		return listing_;
+	}
+
+	// The status of the directory from before it was read.
+	const struct stat &stat() const { return stat_; }
+
+	const std::string &path() const { return path_; }
+
+ private:
+	void Run();
+
+	const std::string path_;
+	struct stat stat_;
+	std::shared_ptr<const DirListing> listing_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable cond_;
+	DirListing pending_;
+	std::size_t count_ = 0;
+	bool done_ = false;
+	bool cancel_ = false;
+	int error_ = 0;
+
+	std::thread thread_;
+};
+
+// Directory listings shared by all FileListers, so that going back and forth
+// in a directory tree does not read and sort the same directories again.
+//
+// A cached listing is used as long as the modification time of the
+// directory is unchanged. With inotify, changes are also picked up on file
+// systems with a coarse modification time, such as FAT.
+//
+// Listings of directories in the library are also taken from and saved to
+// the LibraryIndex, so they survive a restart.
+//
+// Must only be used from the main thread.
+class DirListingCache {
+ public:
+	static DirListingCache &instance();
+
+	DirListingCache(const DirListingCache &) = delete;
+	DirListingCache &operator=(const DirListingCache &) = delete;
+	~DirListingCache();
+
+	// Returns the listing of the given directory, reading it if needed.
+	// Returns nullptr with errno set if the directory cannot be read.
+	std::shared_ptr<const DirListing> Get(const std::string &path);
+
+	// Returns the cached or stored listing of the given directory if it is up
+	// to date, or nullptr.
+	std::shared_ptr<const DirListing> Find(const std::string &path);
+
+	// Adds the listing of a directory that had the given status before it
+	// was read.
+	void Put(const std::string &path, const struct stat &st,
+	         std::shared_ptr<const DirListing> listing);
+
+	// Drops the cached listing of the given directory, if any.
+	void Invalidate(const std::string &path);
+
+ private:
+	struct Entry {
+		std::shared_ptr<const DirListing> listing;
+		struct stat st;  // from before the directory was read
+		int watch;
+		std::uint64_t last_used;
+	};
+
+	DirListingCache();
+
+	// Adds a listing to the cache; returns false if the directory changed
+	// since `st` was taken.
+	bool Insert(const std::string &key, const struct stat &st,
+	            std::shared_ptr<const DirListing> listing);
+	void Erase(std::unordered_map<std::string, Entry>::iterator it);
+	void ProcessEvents();
+
+	std::unordered_map<std::string, Entry> entries_;
+	std::uint64_t clock_ = 0;
+	int inotify_fd_ = -1;
+};
+
+#endif  // _DIR_LISTING_CACHE_H_
@@ -22,17 +22,14 @@
 
 #include "buildopts.h"
 #include "debug.h"
+#include "dir_listing_cache.h"
 #include "utilities.h"
 
-//for browsing the filesystem
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <dirent.h>
 #include <errno.h>
-#include <iostream>
 #include <algorithm>
-#include <cstring>
-#include <set>
+#include <cctype>
+#include <cstdint>
+#include <iterator>
 
 using namespace std;
 
@@ -40,133 +37,188 @@ FileLister::FileLister()
 	: showDirectories(true)
 	, showUpdir(true)
 	, showFiles(true)
+	, scanIncludesUpdir(false)
 {
 }
 
-void FileLister::setFilter(const string &filter)
+FileLister::~FileLister()
 {
-	if (filter.empty() || filter == "*") {
-		this->filter.clear();
-	} else {
-		split(this->filter, filter, ",");
-	}
 }
 
-static void moveNames(set<string, case_less>&& from, vector<string>& to)
+void FileLister::setFilter(const string &filter)
 {
-	to.reserve(from.size());
-	for (string const& name : from) {
-		// Casting away the const is necessary to make the move work.
-		// It will leave the set in an invalid state where it contains multiple
-		// empty strings, but since the set is an rvalue we don't care.
-		to.emplace_back(move(const_cast<string&>(name)));
+	this->filter.clear();
+	if (!filter.empty() && filter != "*") {
+		vector<string> exts;
+		split(exts, filter, ",");
+		for (auto& ext : exts) {
+			// Note: this won't work with UTF8 characters but there
+			// shouldn't be any
+			this->filter.insert(case_less::to_lower(ext));
+		}
 	}
-	to.shrink_to_fit();
 }
 
-bool FileLister::browse(const string& path, bool clean)
+static bool matchesFilter(compat::string_view name,
+		const unordered_set<string> &filter)
 {
-	if (clean) {
-		directories.clear();
-		files.clear();
+	// Determine file extension.
+	const auto dot = name.rfind('.');
+	string lowerExt;
+	if (dot != compat::string_view::npos) {
+		lowerExt.assign(name.data() + dot + 1, name.size() - dot - 1);
+	}
+	for (char& c : lowerExt) {
+		c = tolower(static_cast<unsigned char>(c));
 	}
+	return filter.count(lowerExt) != 0;
+}
 
+static string slashed(const string& path)
+{
 	string slashedPath = path;
 	if (!path.empty() && path[path.length() - 1] != '/') {
 		slashedPath.push_back('/');
 	}
+	return slashedPath;
+}
+
+void FileLister::add(DirListing &&listing, bool includeUpdir, bool sorted)
+{
+	if (showDirectories) {
+		NameList& directorySet = listing.directories;
+		if (!includeUpdir) {
+			directorySet.Filter([](compat::string_view dir) {
+				return dir != "..";
+			});
+		}
+		if (!sorted)
+			directorySet.Sort();
+		directories.Merge(move(directorySet));
+	}
 
-	DIR *dirp;
-	if ((dirp = opendir(slashedPath.c_str())) == NULL) {
+	if (showFiles) {
+		NameList& fileSet = listing.files;
+		if (!filter.empty()) {
+			fileSet.Filter([this](compat::string_view file) {
+				return matchesFilter(file, filter);
+			});
+		}
+		if (!sorted)
+			fileSet.Sort();
+		files.Merge(move(fileSet));
+	}
+}
+
+bool FileLister::browse(const string& path, bool clean)
+{
+	scan.reset();
+	if (clean) {
+		directories.Clear();
+		files.Clear();
+	}
+
+	const string slashedPath = slashed(path);
+	auto listing = DirListingCache::instance().Get(slashedPath);
+	if (!listing) {
 		if (errno != ENOENT) {
 			ERROR("Unable to open directory: %s\n", slashedPath.c_str());
 		}
 		return false;
 	}
 
-	set<string, case_less> directorySet;
-	set<string, case_less> fileSet;
+	add(DirListing(*listing),
+	    showUpdir && slashedPath != GMENU2X_CARD_ROOT "/", true);
+	return true;
+}
 
-	while (struct dirent *dptr = readdir(dirp)) {
-		// Ignore hidden files and optionally "..".
-		if (dptr->d_name[0] == '.') {
-			if (!(dptr->d_name[1] == '.' && showUpdir
-			      && slashedPath != GMENU2X_CARD_ROOT "/")) {
-				continue;
-			}
-		}
+bool FileLister::browseIncremental(const string& path)
+{
+	// Enough entries to fill the first screen.
+	static const size_t FIRST_CHUNK_SIZE = 256;
 
-		bool isDir, isFile;
-#ifdef _DIRENT_HAVE_D_TYPE
-		if (dptr->d_type != DT_UNKNOWN && dptr->d_type != DT_LNK) {
-			isDir = dptr->d_type == DT_DIR;
-			isFile = dptr->d_type == DT_REG;
-		} else
-#endif
-		{
-			string filepath = slashedPath + dptr->d_name;
-			struct stat st;
-			int statRet = stat(filepath.c_str(), &st);
-			if (statRet == -1) {
-				ERROR("Stat failed on '%s' with error '%s'\n", filepath.c_str(), strerror(errno));
-				continue;
-			}
-			isDir = S_ISDIR(st.st_mode);
-			isFile = S_ISREG(st.st_mode);
-		}
+	const string slashedPath = slashed(path);
+	if (DirListingCache::instance().Find(slashedPath)) {
+		return browse(path);
+	}
 
-		if (isDir) {
-			if (!showDirectories)
-				continue;
-
-			directorySet.insert(string(dptr->d_name));
-		} else if (isFile) {
-			if (!showFiles)
-				continue;
-
-			if (filter.empty()) {
-				fileSet.insert(string(dptr->d_name));
-				continue;
-			}
-
-			// Determine file extension.
-			const char *ext = strrchr(dptr->d_name, '.');
-			if (ext) ext++; else ext = "";
-
-			for (auto& filterExt : filter) {
-				// Note: this won't work with UTF8 characters but there shouldn't
-				// be any 
-				if (case_less::to_lower(ext) == case_less::to_lower(filterExt)) {
-					fileSet.insert(string(dptr->d_name));
-					break;
-				}
-			}
+	scan.reset();
+	directories.Clear();
+	files.Clear();
+
+	scan.reset(new DirScan(slashedPath));
+	scanIncludesUpdir = showUpdir && slashedPath != GMENU2X_CARD_ROOT "/";
+	scan->WaitFor(FIRST_CHUNK_SIZE);
+	if (!scan->ok()) {
+		if (errno != ENOENT) {
+			ERROR("Unable to open directory: %s\n", slashedPath.c_str());
 		}
+		scan.reset();
+		return false;
+	}
+	update();
+	return true;
+}
+
+bool FileLister::update()
+{
+	if (!scan) {
+		return false;
 	}
 
-	closedir(dirp);
+	DirListing chunk;
+	const bool done = scan->Take(&chunk);
+	const bool changed = !chunk.directories.empty() || !chunk.files.empty();
+	add(move(chunk), scanIncludesUpdir, false);
 
-	if (!directorySet.empty()) {
-		for (string& dir : directories) {
-			directorySet.emplace(move(dir));
+	if (done) {
+		if (scan->ok()) {
+			DirListingCache::instance().Put(
+					scan->path(), scan->stat(), scan->listing());
 		}
-		directories.clear();
-		moveNames(move(directorySet), directories);
+		scan.reset();
+	}
+	return changed || done;
+}
+
+void FileLister::finish()
+{
+	if (scan) {
+		scan->WaitFor(SIZE_MAX);
+		update();
 	}
+}
 
-	if (!fileSet.empty()) {
-		for (string& file : files) {
-			fileSet.emplace(move(file));
-		}
-		files.clear();
-		moveNames(move(fileSet), files);
+size_t FileLister::scannedCount() const
+{
+	return scan ? scan->count() : size();
+}
+
+int FileLister::indexOf(compat::string_view name, bool isDirectory) const
+{
+	if (isDirectory) {
+		return directories.Find(name);
 	}
+	int index = files.Find(name);
+	return index < 0 ? -1 : directories.size() + index;
+}
 
-	return true;
+int FileLister::findPrefix(compat::string_view prefix) const
+{
+	int index = directories.FindPrefix(prefix);
+	if (index >= 0) {
+		return index;
+	}
+	index = files.FindPrefix(prefix);
+	return index < 0 ? -1 : directories.size() + index;
 }
 
-string FileLister::operator[](size_t x)
+vector<string> FileLister::nextChars(compat::string_view prefix) const
 {
-	const auto dirCount = directories.size();
-	return x < dirCount ? directories[x] : files[x - dirCount];
+	vector<string> dirChars, fileChars, chars;
+	directories.NextChars(prefix, &dirChars);
+	files.NextChars(prefix, &fileChars);
+	set_union(dirChars.begin(), dirChars.end(),
+	          fileChars.begin(), fileChars.end(), back_inserter(chars));
+	return chars;
 }
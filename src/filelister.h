@@ -21,18 +21,34 @@
 #ifndef FILELISTER_H
 #define FILELISTER_H
 
+#include "compat-string_view.h"
+#include "name_list.h"
+
+#include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
+class DirScan;
+struct DirListing;
+
 class FileLister {
 private:
-	std::vector<std::string> filter;
+	/** Lower case file extensions to show, or empty to show all files. */
+	std::unordered_set<std::string> filter;
 	bool showDirectories, showUpdir, showFiles;
 
-	std::vector<std::string> directories, files;
+	NameList directories, files;
+
+	/** Directory being read in the background, if any. */
+	std::unique_ptr<DirScan> scan;
+	bool scanIncludesUpdir;
+
+	void add(DirListing &&listing, bool includeUpdir, bool sorted);
 
 public:
 	FileLister();
+	~FileLister();
 
 	/**
 	 * Scans the given directory.
@@ -42,11 +58,67 @@ public:
 	 */
 	bool browse(const std::string& path, bool clean = true);
 
+	/**
+	 * Like browse(), but if the directory has to be read, only waits for
+	 * the first entries and reads the rest in the background.
+	 * Call update() to add the entries read since.
+	 */
+	bool browseIncremental(const std::string& path);
+
+	/**
+	 * Adds the entries read in the background since the last call.
+	 * This can change the index of existing entries.
+	 * @return True iff the entries or the completion state changed.
+	 */
+	bool update();
+
+	/**
+	 * Waits until the directory has been read completely.
+	 */
+	void finish();
+
+	/** Returns false while a directory is still being read. */
+	bool isComplete() const { return !scan; }
+
+	/** Returns the number of entries read by the background scan so far. */
+	size_t scannedCount() const;
+
+	/**
+	 * Returns the index of the given entry, or -1 if it is not listed.
+	 */
+	int indexOf(compat::string_view name, bool isDirectory) const;
+
+	/**
+	 * Returns the index of an entry whose name starts with the given prefix,
+	 * ignoring the case of ASCII letters, or -1 if there is none. Directories
+	 * are tried first; see NameList::FindPrefix() for which entry is picked.
+	 */
+	int findPrefix(compat::string_view prefix) const;
+
+	/**
+	 * Returns the characters that follow the given prefix in the names of
+	 * the entries, in order and without duplicates. Letters are matched like
+	 * in findPrefix() and returned in lower case.
+	 */
+	std::vector<std::string> nextChars(compat::string_view prefix) const;
+
 	size_t size() const { return files.size() + directories.size(); }
 	size_t dirCount() const { return directories.size(); }
 	size_t fileCount() const { return files.size(); }
 
-	std::string operator[](size_t);
+	/**
+	 * Returns the name of entry x. The view is valid until the listing
+	 * changes.
+	 */
+	compat::string_view operator[](size_t x) const {
+		const auto dirCount = directories.size();
+		return x < dirCount ? directories[x] : files[x - dirCount];
+	}
+	/** Returns the name of entry x without its extension. */
+	compat::string_view stem(size_t x) const {
+		const auto dirCount = directories.size();
+		return x < dirCount ? directories.stem(x) : files.stem(x - dirCount);
+	}
 	bool isFile(size_t x) const { return x >= directories.size(); }
 	bool isDirectory(size_t x) const { return x < directories.size(); }
 
@@ -56,8 +128,8 @@ public:
 	void setShowUpdir(bool enabled) { showUpdir = enabled; }
 	void setShowFiles(bool enabled) { showFiles = enabled; }
 
-	const std::vector<std::string> &getDirectories() const { return directories; }
-	const std::vector<std::string> &getFiles() const { return files; }
+	std::vector<std::string> getDirectories() const { return directories.ToVector(); }
+	std::vector<std::string> getFiles() const { return files.ToVector(); }
 };
 
 #endif // FILELISTER_H
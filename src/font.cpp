@@ -12,8 +12,42 @@
 #include <cassert>
 #include <vector>
 
+namespace {
+
+int alignTop(int y, Font::VAlign valign, int lineSpacing) {
+	switch (valign) {
+	case Font::VAlignTop:
+		break;
+	case Font::VAlignMiddle:
+		y -= lineSpacing / 2;
+		break;
+	case Font::VAlignBottom:
+		y -= lineSpacing;
+		break;
+	}
+	return y;
+}
+
+int alignLeft(int x, Font::HAlign halign, int width) {
+	switch (halign) {
+	case Font::HAlignLeft:
+		break;
+	case Font::HAlignCenter:
+		x -= width / 2;
+		break;
+	case Font::HAlignRight:
+		x -= width;
+		break;
+	}
+	return x;
+}
+
+}  // namespace
+
 Font::Font(Font &&other) noexcept
     : font(other.font),
+      ttfFailed(other.ttfFailed),
+      bitmap(std::move(other.bitmap)),
       lineSpacing(other.lineSpacing),
       spec_(std::move(other.spec_)) {
 	other.font = nullptr;
@@ -26,6 +60,8 @@ Font &Font::operator=(Font &&other) noexcept {
 	}
 	font = other.font;
 	other.font = nullptr;
+	ttfFailed = other.ttfFailed;
+	bitmap = std::move(other.bitmap);
 	lineSpacing = other.lineSpacing;
 	spec_ = std::move(other.spec_);
 	return *this;
@@ -35,10 +71,27 @@ bool Font::Load(FontSpec spec)
 {
 	spec_ = std::move(spec);
 
+	bitmap = BitmapFont::Open(spec_);
+	if (bitmap) {
+		INFO("Loaded bitmap font '%s'\n",
+		     BitmapFont::PathFor(spec_).c_str());
+		lineSpacing = bitmap->getLineSpacing();
+		return true;
+	}
+
+	if (!openTTF())
+		return false;
+	lineSpacing = TTF_FontLineSkip(font);
+	return true;
+}
+
+bool Font::openTTF() const
+{
 	/* Note: TTF_Init and TTF_Quit perform reference counting, so call them
 	 * both unconditionally for each font. */
 	if (TTF_Init() < 0) {
 		ERROR("Unable to init SDL_ttf library\n");
+		ttfFailed = true;
 		return false;
 	}
 
@@ -48,13 +101,32 @@ bool Font::Load(FontSpec spec)
 	} else {
 		WARNING("Unable to open font '%s'\n", spec_.path.c_str());
 		SDL_ClearError();
+		TTF_Quit();
+		ttfFailed = true;
 		return false;
 	}
-
-	lineSpacing = TTF_FontLineSkip(font);
 	return true;
 }
 
+TTF_Font *Font::ttf() const
+{
+	if (!font && !ttfFailed)
+		openTTF();
+	return font;
+}
+
+bool Font::HasGlyph(std::uint16_t code_point) const
+{
+	if (bitmap) {
+		if (bitmap->HasGlyph(code_point))
+			return true;
+		if (bitmap->isComplete())
+			return false;
+	}
+	TTF_Font *ttf_font = ttf();
+	return ttf_font && TTF_GlyphIsProvided(ttf_font, code_point);
+}
+
 Font::~Font()
 {
 	if (font) {
@@ -70,36 +142,22 @@ int Font::writeLine(Surface& surface, const std::uint16_t *text, int x, int y,
 		return 0;
 	}
 
-	switch (valign) {
-	case VAlignTop:
-		break;
-	case VAlignMiddle:
-		y -= lineSpacing / 2;
-		break;
-	case VAlignBottom:
-		y -= lineSpacing;
-		break;
+	TTF_Font *ttf_font = ttf();
+	if (!ttf_font) {
+		return 0;
 	}
 
+	y = alignTop(y, valign, lineSpacing);
+
 	SDL_Color color = { 0, 0, 0, 0 };
-	SDL_Surface *s = TTF_RenderUNICODE_Blended(font, text, color);
+	SDL_Surface *s = TTF_RenderUNICODE_Blended(ttf_font, text, color);
 	if (!s) {
 		ERROR("Font rendering failed: %s\n", SDL_GetError());
 		SDL_ClearError();
 		return 0;
 	}
 	const int width = s->w;
-
-	switch (halign) {
-	case HAlignLeft:
-		break;
-	case HAlignCenter:
-		x -= width / 2;
-		break;
-	case HAlignRight:
-		x -= width;
-		break;
-	}
+	x = alignLeft(x, halign, width);
 
 	SDL_Rect rect = { (Sint16) x, (Sint16) (y - 1), 0, 0 };
 	SDL_BlitSurface(s, NULL, surface.raw, &rect);
@@ -125,7 +183,7 @@ int Font::writeLine(Surface& surface, const std::uint16_t *text, int x, int y,
 	color.g = 0xff;
 	color.b = 0xff;
 
-	s = TTF_RenderUNICODE_Blended(font, text, color);
+	s = TTF_RenderUNICODE_Blended(ttf_font, text, color);
 	if (!s) {
 		ERROR("Font rendering failed: %s\n", SDL_GetError());
 		SDL_ClearError();
@@ -136,3 +194,22 @@ int Font::writeLine(Surface& surface, const std::uint16_t *text, int x, int y,
 
 	return width;
 }
+
+int Font::writeBitmapLine(Surface& surface, const std::uint16_t *text,
+                          int x, int y, HAlign halign, VAlign valign) const {
+	SDL_Surface *s = bitmap->RenderOutlined(text);
+	if (!s) {
+		return 0;
+	}
+	// The outline adds one pixel on every side.
+	const int width = s->w - 2;
+
+	y = alignTop(y, valign, lineSpacing);
+	x = alignLeft(x, halign, width);
+
+	SDL_Rect rect = { (Sint16) (x - 1), (Sint16) (y - 1), 0, 0 };
+	SDL_BlitSurface(s, NULL, surface.raw, &rect);
+	SDL_FreeSurface(s);
+
+	return width;
+}
@@ -10,6 +10,7 @@
 
 #include <SDL_ttf.h>
 
+#include "bitmap_font.h"
 #include "font_spec.h"
 
 class FontStack;
@@ -20,6 +21,8 @@ class Surface;
  * Wrapper around a TrueType or other FreeType-supported font.
  * The wrapper is valid even if the font couldn't be loaded, but in that case
  * nothing will be drawn.
+ * If a precompiled bitmap version of the font exists, glyphs are drawn from
+ * that and the font itself is only opened when a glyph is missing from it.
  */
 class Font {
 public:
@@ -44,9 +47,7 @@ public:
 		return lineSpacing;
 	}
 
-	bool HasGlyph(std::uint16_t code_point) const {
-		return TTF_GlyphIsProvided(font, code_point);
-	}
+	bool HasGlyph(std::uint16_t code_point) const;
 
 	const FontSpec& spec() const { return spec_; }
 
@@ -60,7 +61,24 @@ private:
 	int writeLine(Surface& surface, const std::uint16_t *text, int x, int y,
 	              HAlign halign, VAlign valign) const;
 
-	TTF_Font *font;
+	/**
+	 * Same as writeLine, but draws from the bitmap font. All code points in
+	 * the text must be in the bitmap font.
+	 */
+	int writeBitmapLine(Surface& surface, const std::uint16_t *text,
+	                    int x, int y, HAlign halign, VAlign valign) const;
+
+	/**
+	 * Returns the SDL_ttf font, opening it first if it was deferred because
+	 * of the bitmap font. Returns nullptr if it cannot be opened.
+	 */
+	TTF_Font *ttf() const;
+
+	bool openTTF() const;
+
+	mutable TTF_Font *font = nullptr;
+	mutable bool ttfFailed = false;
+	std::unique_ptr<BitmapFont> bitmap;
 	int lineSpacing;
 	FontSpec spec_;
 
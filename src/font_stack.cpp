@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstring>
 #include <iterator>
 #include <type_traits>
 #include <unordered_map>
@@ -45,19 +46,6 @@ bool FontSpecsEq(const std::vector<Font> &fonts,
 	return true;
 }
 
-template <std::size_t N>
-void BuildCodePointToFontMap(const std::vector<Font> &fonts,
-                             std::array<const Font *, N> *map) {
-	for (std::size_t cp = 0; cp < N; ++cp) {
-		(*map)[cp] = &fonts[0];
-		for (const auto &font : fonts) {
-			if (!font.HasGlyph(cp)) continue;
-			(*map)[cp] = &font;
-			break;
-		}
-	}
-}
-
 std::uint8_t *get_pixel8(const SDL_Surface *s, int row, int col) {
 	const std::uintptr_t row_addr =
 	    reinterpret_cast<std::uintptr_t>(s->pixels) + row * s->pitch;
@@ -172,31 +160,54 @@ bool FontStack::LoadFonts(std::initializer_list<FontSpec> specs) {
 	}
 	fonts_ = std::move(fonts);
 
-	BuildCodePointToFontMap(fonts_, &code_point_to_font_);
+	code_point_to_font_.fill(nullptr);
 
 	return true;
 }
 
+const Font *FontStack::FontFor(std::uint16_t code_point) const {
+	const Font *&font = code_point_to_font_[code_point];
+	if (font == nullptr) {
+		font = &fonts_[0];
+		for (const auto &f : fonts_) {
+			if (!f.HasGlyph(code_point)) continue;
+			font = &f;
+			break;
+		}
+	}
+	return font;
+}
+
+const BitmapFont *FontStack::BitmapFor(const Font *font,
+                                       std::uint16_t code_point) {
+	const BitmapFont *bitmap = font->bitmap.get();
+	return bitmap != nullptr && bitmap->HasGlyph(code_point) ? bitmap : nullptr;
+}
+
 void FontStack::ForEachSlice(
     const std::vector<std::uint16_t> &code_points,
     std::function<void(const FontStack::Slice &slice)> fn) const {
 	if (code_points[0] == 0) return;
-	if (fonts_.size() == 1) {
-		fn(Slice{code_points.data(), code_points.size() - 1, &fonts_[0]});
+	if (fonts_.size() == 1 && fonts_[0].bitmap == nullptr) {
+		fn(Slice{code_points.data(), code_points.size() - 1, &fonts_[0],
+		         nullptr});
 		return;
 	}
-	const Font *prev_font = code_point_to_font_[code_points[0]];
-	Slice cur_slice{code_points.data(), 1, prev_font};
+	const Font *prev_font = FontFor(code_points[0]);
+	const BitmapFont *prev_bitmap = BitmapFor(prev_font, code_points[0]);
+	Slice cur_slice{code_points.data(), 1, prev_font, prev_bitmap};
 	for (std::size_t i = 1; i < code_points.size(); ++i) {
 		auto &cp = code_points[i];
 		if (cp == 0) break;
-		const Font *cur_font = code_point_to_font_[cp];
-		if (cur_font == prev_font) {
+		const Font *cur_font = FontFor(cp);
+		const BitmapFont *cur_bitmap = BitmapFor(cur_font, cp);
+		if (cur_font == prev_font && cur_bitmap == prev_bitmap) {
 			++cur_slice.text_size;
 		} else {
 			fn(cur_slice);
-			cur_slice = Slice{&cp, 1, cur_font};
+			cur_slice = Slice{&cp, 1, cur_font, cur_bitmap};
 			prev_font = cur_font;
+			prev_bitmap = cur_bitmap;
 		}
 	}
 	fn(cur_slice);
@@ -233,8 +244,12 @@ int FontStack::getTextWidth(compat::string_view text) const {
 	int max_width = 0;
 	for (compat::string_view line : SplitByChar(text, '\n')) {
 		ForEachSliceZeroTerminated(line, [&max_width](const Slice &slice) {
-			int w;
-			TTF_SizeUNICODE(slice.font->font, slice.text, &w, nullptr);
+			int w = 0;
+			if (slice.bitmap != nullptr) {
+				w = slice.bitmap->getTextWidth(slice.text);
+			} else if (TTF_Font *font = slice.font->ttf()) {
+				TTF_SizeUNICODE(font, slice.text, &w, nullptr);
+			}
 			max_width = std::max(max_width, w);
 		});
 	}
@@ -261,8 +276,13 @@ int FontStack::write(Surface &surface, compat::string_view text, int x, int y,
 		int line_spacing = line.empty() ? fonts_[0].getLineSpacing() : 0;
 		int line_width = 0;
 		ForEachSliceZeroTerminated(line, [&](const Slice &slice) {
-			line_width += slice.font->writeLine(surface, slice.text, x + line_width,
-			                                    y, halign, valign);
+			if (slice.bitmap != nullptr) {
+				line_width += slice.font->writeBitmapLine(
+				    surface, slice.text, x + line_width, y, halign, valign);
+			} else {
+				line_width += slice.font->writeLine(
+				    surface, slice.text, x + line_width, y, halign, valign);
+			}
 			line_spacing = std::max(line_spacing, slice.font->getLineSpacing());
 		});
 		max_width = std::max(max_width, line_width);
@@ -276,8 +296,15 @@ std::unique_ptr<OffscreenSurface> FontStack::render(
 	std::vector<SDL_Surface *> surfaces;
 	int width = 0, height = 0;
 	ForEachSliceZeroTerminated(text, [&](const Slice &slice) {
-		SDL_Surface *s = TTF_RenderUNICODE_Shaded(slice.font->font, slice.text,
-		                                          SDL_Color{}, SDL_Color{});
+		SDL_Surface *s;
+		if (slice.bitmap != nullptr) {
+			s = slice.bitmap->RenderShaded(slice.text);
+			if (s == nullptr) return;
+		} else {
+			TTF_Font *font = slice.font->ttf();
+			if (font == nullptr) return;
+			s = TTF_RenderUNICODE_Shaded(font, slice.text, SDL_Color{}, SDL_Color{});
+		}
 		if (s == nullptr) {
 			ERROR("TTF_RenderUNICODE_Shaded: %s\n", SDL_GetError());
 			SDL_ClearError();
@@ -293,16 +320,16 @@ std::unique_ptr<OffscreenSurface> FontStack::render(
 	if (surfaces.size() == 1) {
 		concatenated = surfaces[0];
 	} else {
-		const SDL_PixelFormat *fmt = surfaces[0]->format;
 		concatenated =
-		    SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, fmt->BitsPerPixel,
-		                         fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+		    SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 8, 0, 0, 0, 0);
+		// The slices are coverage maps rather than colors, so copy the bytes
+		// instead of blitting, which would map them through the palettes.
 		int x = 0;
 		for (SDL_Surface *src : surfaces) {
-			SDL_Rect dest_rect = {
-			    static_cast<decltype(SDL_Rect().x)>(x),
-			    static_cast<decltype(SDL_Rect().y)>(height - src->h), 0, 0};
-			SDL_BlitSurface(src, nullptr, concatenated, &dest_rect);
+			for (int row = 0; row < src->h; ++row) {
+				std::memcpy(get_pixel8(concatenated, height - src->h + row, x),
+				            get_pixel8(src, row, 0), src->w);
+			}
 			x += src->w;
 			SDL_FreeSurface(src);
 		}
@@ -34,9 +34,19 @@ class FontStack {
 		const std::uint16_t *text;
 		std::size_t text_size;
 		const Font *font;
+		// Set if the slice is drawn from the font's bitmap font.
+		const BitmapFont *bitmap;
 	};
 
-	// Calls the given function for each span of same-font code points.
+	// Returns the font to draw the given code point with.
+	const Font *FontFor(std::uint16_t code_point) const;
+
+	// Returns the bitmap font to draw the given code point with, if any.
+	static const BitmapFont *BitmapFor(const Font *font,
+	                                   std::uint16_t code_point);
+
+	// Calls the given function for each span of code points drawn by the same
+	// font.
 	void ForEachSlice(const std::vector<std::uint16_t> &code_points,
 	                  std::function<void(const Slice &slice)> fn) const;
 
@@ -60,9 +70,11 @@ class FontStack {
 
 	// A map from code point to the font that contains it.
 	// If no font contains a given code point, maps to the first font.
+	// Filled in lazily by `FontFor`; nullptr means not looked up yet.
 	//
 	// Only covers BMP because SDL 1 does not support anything else.
-	std::array<const Font *, std::numeric_limits<std::uint16_t>::max() + 1>
+	mutable std::array<const Font *,
+	                   std::numeric_limits<std::uint16_t>::max() + 1>
 	    code_point_to_font_;
 
 	// The maximum of line spacings of all fonts.
@@ -18,6 +18,7 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include "app_importer.h"
 #include "background.h"
 #include "brightnessmanager.h"
 #include "buildopts.h"
@@ -32,6 +33,7 @@
 #include "iconbutton.h"
 #include "inputdialog.h"
 #include "launcher.h"
+#include "library_index.h"
 #include "linkapp.h"
 #include "mediamonitor.h"
 #include "menu.h"
@@ -45,6 +47,8 @@
 #include "menusettingstring.h"
 #include "messagebox.h"
 #include "powersaver.h"
+#include "search_service.h"
+#include "searchdialog.h"
 #include "settingsdialog.h"
 #include "textdialog.h"
 #include "wallpaperdialog.h"
@@ -345,6 +349,8 @@ void GMenu2X::initBG() {
 	(void)serviceX;
 
 	bgmain->convertToDisplayFormat();
+
+	if (menu) menu->backgroundChanged();
 }
 
 bool GMenu2X::initFont() {
@@ -370,6 +376,10 @@ void GMenu2X::initMenu() {
 			bind(&GMenu2X::explorer, this),
 			tr["Launch an application"],
 			"skin:icons/explorer.png");
+	menu->addActionLink(appIdx, tr["Search"],
+			bind(&GMenu2X::search, this),
+			tr["Find links and files by name"],
+			"skin:icons/explorer.png");
 
 	// Add action links in the settings section.
 	auto settingIdx = menu->sectionNamed("settings");
@@ -391,18 +401,27 @@ void GMenu2X::initMenu() {
 				tr["Displays last launched program's output"],
 				"skin:icons/ebook.png");
 	}
+	menu->addActionLink(settingIdx, tr["Import apps"],
+			bind(&GMenu2X::importApps, this),
+			tr["Add links to the applications found on the system"],
+			"skin:icons/configure.png");
 	menu->addActionLink(settingIdx, tr["About"],
 			bind(&GMenu2X::about, this),
 			tr["Info about GMenu2X"],
 			"skin:icons/about.png");
 
 	menu->skinUpdated();
-	menu->orderLinks();
 
 	menu->setSectionIndex(confInt["section"]);
 	menu->setLinkIndex(confInt["link"]);
 
 	layers.push_back(menu);
+
+	updateLibraryRoots();
+}
+
+void GMenu2X::updateLibraryRoots() {
+	LibraryIndex::instance().SetRoots(menu->getSelectorDirs());
 }
 
 void GMenu2X::about() {
@@ -430,6 +449,39 @@ void GMenu2X::viewLog() {
 	}
 }
 
+void GMenu2X::importApps() {
+	AppImporter importer(getHome() + "/sections",
+			{ GMENU2X_SYSTEM_DIR "/sections" });
+	vector<string> dirs;
+	split(dirs, confStr["appDirs"], ",");
+	for (auto &dir : dirs) {
+		dir = trim(dir);
+		if (!dir.empty()) importer.Scan(dir);
+	}
+
+	if (importer.apps().empty()) {
+		MessageBox mb(*this, tr["No new applications found"],
+				"icons/configure.png");
+		mb.exec();
+		return;
+	}
+
+	bool written = importer.Write();
+	vector<pair<string, string>> sectionFiles;
+	for (auto const& app : importer.apps()) {
+		if (!app.file.empty())
+			sectionFiles.emplace_back(app.section, app.file);
+	}
+	menu->importLinks(sectionFiles);
+
+	string count = to_string(sectionFiles.size());
+	string text = tr.translate("Imported $1 applications", count.c_str(), NULL);
+	if (!written)
+		text += "\n" + tr["Some links could not be written"];
+	MessageBox mb(*this, text, "icons/configure.png");
+	mb.exec();
+}
+
 void GMenu2X::readConfig() {
 	string conffile = GMENU2X_SYSTEM_DIR "/gmenu2x.conf";
 	readConfig(conffile);
@@ -471,6 +523,8 @@ void GMenu2X::readConfig(string conffile) {
 	evalIntConf( confInt, "videoBpp", 32, 16, 32 );
 
 	if (confStr["tvoutEncoding"] != "PAL") confStr["tvoutEncoding"] = "NTSC";
+	if (confStr.find("appDirs") == confStr.end())
+		confStr["appDirs"] = "/usr/games,/usr/local/games";
 }
 
 void GMenu2X::saveSelection() {
@@ -571,6 +625,13 @@ void GMenu2X::mainLoop() {
 		menu->selLinkApp()->selector(lastSelectorElement, lastSelectorDir);
 
 	while (true) {
+#if defined(HAVE_LIBOPK) && defined(ENABLE_INOTIFY)
+		// Apply the package changes that the monitors have queued.
+		menu->applyPackageEvents();
+#endif
+		// Remove the links whose targets were found missing.
+		menu->applyTargetChecks();
+
 		// Remove dismissed layers from the stack.
 		for (auto it = layers.begin(); it != layers.end(); ) {
 			if ((*it)->getStatus() == Layer::Status::DISMISSED) {
@@ -631,6 +692,36 @@ void GMenu2X::explorer() {
 	}
 }
 
+void GMenu2X::search() {
+	if (!searchService) searchService.reset(new SearchService());
+	searchService->Refresh(*menu);
+
+	SearchDialog sd(*this, *searchService);
+	if (!sd.exec()) return;
+	const SearchIndex::Document &result = sd.getResult();
+	const string &file = result.kind == SearchIndex::Kind::kLink
+			? result.target : result.owner;
+
+	// Select the link of the result, so it is the selection after launching.
+	for (uint32_t i = 0; i < menu->getSections().size(); i++) {
+		auto &links = *menu->sectionLinks(i);
+		for (uint32_t j = 0; j < links.size(); j++) {
+			LinkApp *app = LinkApp::from(links[j].get());
+			if (!app || app->getFile() != file) continue;
+
+			menu->setSectionIndex(i);
+			menu->setLinkIndex(j);
+			if (result.kind == SearchIndex::Kind::kLink) {
+				app->run();
+			} else {
+				app->launch(result.target);
+			}
+			return;
+		}
+	}
+	WARNING("Link '%s' of search result no longer exists\n", file.c_str());
+}
+
 void GMenu2X::queueLaunch(
 	unique_ptr<Launcher>&& launcher, shared_ptr<Layer> launchLayer
 ) {
@@ -713,13 +804,14 @@ void GMenu2X::skinMenu() {
 	fl_sk.browse(getLocalSkinTopPath());
 	fl_sk.browse(getSystemSkinTopPath(), false);
 
+	vector<string> skins = fl_sk.getDirectories();
 	string curSkin = confStr["skin"];
 
 	SettingsDialog sd(*this, input, tr["Skin"]);
 	sd.addSetting(unique_ptr<MenuSetting>(new MenuSettingMultiString(
 			*this, tr["Skin"],
 			tr["Set the skin used by GMenu2X"],
-			&confStr["skin"], &fl_sk.getDirectories())));
+			&confStr["skin"], &skins)));
 	sd.addSetting(unique_ptr<MenuSetting>(new MenuSettingRGBA(
 			*this, tr["Top Bar"],
 			tr["Color of the top bar"],
@@ -794,15 +886,16 @@ void GMenu2X::setSkin(const string &skin, bool setWallpaper) {
 	evalIntConf(skinConfInt, "linkHeight", 50, 32, 120);
 	evalIntConf(skinConfInt, "linkWidth", 80, 32, 120);
 
+	//Selection png, before the menu looks it up
+	if (!skinConfInt["selectionBgUseColor"])
+		useSelectionPng = !!sc.addSkinRes("imgs/selection.png", false);
+
 	const bool fontChanged = initFont();
+	if (fontChanged) wrappedText.Clear();
 	if (menu != nullptr) {
 		menu->skinUpdated();
 		if (fontChanged) menu->fontChanged();
 	}
-
-	//Selection png
-	if (!skinConfInt["selectionBgUseColor"])
-		useSelectionPng = !!sc.addSkinRes("imgs/selection.png", false);
 }
 
 bool GMenu2X::readSkinConfig(const string& conffile)
@@ -948,6 +1041,7 @@ void GMenu2X::editLink() {
 					oldSection.c_str(), newSection.c_str());
 			menu->moveSelectedLink(newSection);
 		}
+		updateLibraryRoots();
 	}
 }
 
@@ -1000,7 +1094,7 @@ string GMenu2X::getDiskFree(const char *path) {
 }
 
 int GMenu2X::drawButton(Surface& surface, const string &btn,
-			const string &text, int x, int y) {
+			compat::string_view text, int x, int y) {
 	int w = 0;
 	auto icon = sc["skin:imgs/buttons/" + btn + ".png"];
 	if (icon) {
@@ -1018,7 +1112,7 @@ int GMenu2X::drawButton(Surface& surface, const string &btn,
 }
 
 int GMenu2X::drawButtonRight(Surface& surface, const string &btn,
-			     const string &text, int x, int y) {
+			     compat::string_view text, int x, int y) {
 	int w = 0;
 	auto icon = sc["skin:imgs/buttons/" + btn + ".png"];
 	if (icon) {
@@ -22,6 +22,7 @@
 #define GMENU2X_H
 
 #include "buildopts.h"
+#include "compat-string_view.h"
 #include "contextmenu.h"
 #include "cpu.h"
 #include "surfacecollection.h"
@@ -30,6 +31,7 @@
 #include "powersaver.h"
 #include "surface.h"
 #include "utilities.h"
+#include "wrapped_text_cache.h"
 
 #include <iostream>
 #include <memory>
@@ -45,6 +47,7 @@ class Launcher;
 class Layer;
 class MediaMonitor;
 class Menu;
+class SearchService;
 
 const int LOOP_DELAY = 30000;
 
@@ -69,6 +72,7 @@ private:
 	MediaMonitor *monitor;
 #endif
 	std::unique_ptr<BrightnessManager> brightnessmanager;
+	std::unique_ptr<SearchService> searchService;
 
 	std::unique_ptr<Launcher> toLaunch;
 
@@ -85,6 +89,11 @@ private:
 	*/
 	void explorer();
 
+	/*!
+	Searches the links and the files of their selectors and launches the chosen one
+	*/
+	void search();
+
 	bool inet, //!< Represents the configuration of the basic network services. @see readCommonIni @see usbnet @see samba @see web
 		usbnet,
 		samba,
@@ -104,6 +113,11 @@ private:
 	void initMenu();
 	void initBG();
 
+	/*!
+	Keeps the selector directories of all links in the library index
+	*/
+	void updateLibraryRoots();
+
 	std::string getLocalSkinTopPath() const {
 		return getHome() + "/skins/" + std::to_string(width())
 			+ "x" + std::to_string(height());
@@ -171,6 +185,8 @@ public:
 	/** Background with empty top bar and a partially filled bottom bar. */
 	std::unique_ptr<OffscreenSurface> bgmain;
 	std::unique_ptr<FontStack> font;
+	/** Pre-rendered dialog titles. */
+	WrappedTextCache wrappedText;
 
 	//Status functions
 	void mainLoop();
@@ -181,6 +197,7 @@ public:
 	void skinMenu();
 	void about();
 	void viewLog();
+	void importApps();
 	void changeWallpaper();
 
 	/**
@@ -202,8 +219,8 @@ public:
 	void addSection();
 	void deleteSection();
 
-	int drawButton(Surface& s, const std::string &btn, const std::string &text, int x=5, int y=-10);
-	int drawButtonRight(Surface& s, const std::string &btn, const std::string &text, int x=5, int y=-10);
+	int drawButton(Surface& s, const std::string &btn, compat::string_view text, int x=5, int y=-10);
+	int drawButtonRight(Surface& s, const std::string &btn, compat::string_view text, int x=5, int y=-10);
 	void drawScrollBar(uint32_t pageSize, uint32_t totalSize, uint32_t pagePos);
 
 	void drawTopBar(Surface& s);
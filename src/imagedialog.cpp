@@ -22,6 +22,8 @@
 
 #include "filelister.h"
 #include "gmenu2x.h"
+#include "surface.h"
+#include "thumbnail_cache.h"
 #include "utilities.h"
 
 #include <SDL.h>
@@ -36,8 +38,7 @@ using namespace std;
 ImageDialog::ImageDialog(
 		GMenu2X& gmenu2x, const string &text,
 		const string &filter, const string &file)
-	: FileDialog(gmenu2x, text, filter, file, "Image Browser"),
-	previews(&gmenu2x)
+	: FileDialog(gmenu2x, text, filter, file, "Image Browser")
 {
 
 	string path;
@@ -51,14 +52,24 @@ ImageDialog::ImageDialog(
 }
 
 ImageDialog::~ImageDialog() {
-	previews.clear();
 }
 
 void ImageDialog::beforeFileList() {
-	if (fl.isFile(selected) && fileExists(getPath()+"/"+fl[selected]))
-		previews[getPath()+"/"+fl[selected]]->blitRight(*gmenu2x.s, 310, 43);
+	if (!fl.isFile(selected))
+		return;
+	const string path = getPath() + "/" + getFile();
+	if (path != previewPath) {
+		previewPath = path;
+		unsigned int top, height;
+		tie(top, height) = gmenu2x.getContentArea();
+		preview = ThumbnailCache::instance().Get(
+				path, gmenu2x.width() / 2, height, true);
+	}
+	if (preview)
+		preview->blitRight(*gmenu2x.s, 310, 43);
 }
 
 void ImageDialog::onChangeDir() {
-	previews.clear();
+	preview.reset();
+	previewPath.clear();
 }
@@ -22,13 +22,16 @@
 #define IMAGEDIALOG_H
 
 #include "filedialog.h"
-#include "surfacecollection.h"
 
+#include <memory>
 #include <string>
 
+class OffscreenSurface;
+
 class ImageDialog : public FileDialog {
 protected:
-	SurfaceCollection previews;
+	std::unique_ptr<OffscreenSurface> preview;
+	std::string previewPath;
 public:
 	ImageDialog(
 			GMenu2X& gmenu2x, const std::string &text,
@@ -16,6 +16,8 @@
 #ifdef HAVE_LIBOPK
 #include <opk.h>
 
+#include "opk_icon_cache.h"
+
 static void __readFromOpk(png_structp png_ptr, png_bytep ptr, png_size_t length)
 {
 	char **buf = (char **) png_get_io_ptr(png_ptr);
@@ -26,6 +28,17 @@ static void __readFromOpk(png_structp png_ptr, png_bytep ptr, png_size_t length)
 #endif
 
 SDL_Surface *loadPNG(const std::string &path, bool loadAlpha) {
+#ifdef HAVE_LIBOPK
+	std::string::size_type pos = path.find('#');
+	if (pos != path.npos) {
+		return OpkIconCache::instance().Load(
+				path.substr(0, pos), path.substr(pos + 1), loadAlpha);
+	}
+#endif
+	return readPNG(path, loadAlpha);
+}
+
+SDL_Surface *readPNG(const std::string &path, bool loadAlpha) {
 	// Declare these with function scope and initialize them to NULL,
 	// so we can use a single cleanup block at the end of the function.
 	SDL_Surface *surface = NULL;
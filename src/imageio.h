@@ -6,7 +6,13 @@
 struct SDL_Surface;
 
 /** Loads an image from a PNG file into a newly allocated 32bpp RGBA surface.
+  * A path of the form "package.opk#icon.png" names a file in a package;
+  * those are served from the package icon cache.
   */
 SDL_Surface *loadPNG(const std::string &path, bool loadAlpha = true);
 
+/** Like loadPNG, but always decodes the file, even when it is in a package.
+  */
+SDL_Surface *readPNG(const std::string &path, bool loadAlpha = true);
+
 #endif
@@ -43,6 +43,8 @@ InputDialog::InputDialog(GMenu2X& gmenu2x, InputManager &inputMgr_,
 		const string &startvalue, const string &title, const string &icon)
 	: Dialog(gmenu2x)
 	, inputMgr(inputMgr_)
+	, cancelLabel(gmenu2x.tr.get("Cancel"))
+	, okLabel(gmenu2x.tr.get("OK"))
 {
 	if (title.empty()) {
 		this->title = text;
@@ -323,14 +325,14 @@ void InputDialog::drawVirtualKeyboard() {
 		KEY_HEIGHT - 1
 	};
 	s.rectangle(re, gmenu2x.skinConfColors[COLOR_SELECTION_BG]);
-	gmenu2x.font->write(s, gmenu2x.tr["Cancel"],
+	gmenu2x.font->write(s, cancelLabel,
 			(int)(160 - kbLength * KEY_WIDTH / 4),
 			KB_TOP + kb->size() * KEY_HEIGHT + KEY_HEIGHT / 2,
 			Font::HAlignCenter, Font::VAlignMiddle);
 
 	re.x = kbLeft + kbLength * KEY_WIDTH / 2 - 1;
 	s.rectangle(re, gmenu2x.skinConfColors[COLOR_SELECTION_BG]);
-	gmenu2x.font->write(s, gmenu2x.tr["OK"],
+	gmenu2x.font->write(s, okLabel,
 			(int)(160 + kbLength * KEY_WIDTH / 4),
 			KB_TOP + kb->size() * KEY_HEIGHT + KEY_HEIGHT / 2,
 			Font::HAlignCenter, Font::VAlignMiddle);
@@ -23,6 +23,7 @@
 
 #include "dialog.h"
 #include "buttonbox.h"
+#include "compat-string_view.h"
 
 #include <SDL.h>
 #include <string>
@@ -59,6 +60,8 @@ private:
 	SDL_Rect kbRect;
 	ButtonBox buttonbox;
 	std::string input;
+	// Translated once, since the keyboard is redrawn every frame.
+	compat::string_view cancelLabel, okLabel;
 };
 
 #endif // INPUTDIALOG_H
@@ -0,0 +1,148 @@
+#include "jump_bar.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include "collation.h"
+#include "filelister.h"
+#include "gmenu2x.h"
+#include "surface.h"
+
+namespace {
+
+// Number of characters shown before the current one, if there are more
+// candidates than fit in the bar.
+constexpr std::size_t kCharsBefore = 4;
+
+bool IsContinuation(char c) {
+	return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// Returns the first character of `text`, in lower case like the characters
+// of the file lister.
+std::string FirstChar(compat::string_view text) {
+	std::size_t end = std::min<std::size_t>(1, text.size());
+	while (end < text.size() && IsContinuation(text[end])) ++end;
+	std::string c(text.data(), end);
+	if (!c.empty()) c[0] = FoldCase(c[0]);
+	return c;
+}
+
+// Removes the last character from `text` and returns it.
+std::string PopChar(std::string *text) {
+	std::size_t start = text->size();
+	while (start > 0 && IsContinuation((*text)[start - 1])) --start;
+	if (start > 0) --start;
+	std::string c = text->substr(start);
+	text->resize(start);
+	return c;
+}
+
+}  // namespace
+
+JumpBar::JumpBar(GMenu2X &gmenu2x) : gmenu2x_(gmenu2x) {}
+
+void JumpBar::Open(const FileLister &fl, unsigned int *selected) {
+	prefix_.clear();
+	Refresh(fl, *selected < fl.size() ? FirstChar(fl[*selected]) : "");
+	if (chars_.empty()) return;
+
+	open_ = true;
+	opened_selection_ = *selected;
+	Jump(fl, selected);
+}
+
+void JumpBar::HandleButton(InputManager::Button button, const FileLister &fl,
+                           unsigned int *selected) {
+	// Entries may have been added since the last press.
+	Refresh(fl, chars_.empty() ? "" : chars_[current_]);
+
+	switch (button) {
+		case InputManager::UP:
+			if (chars_.empty()) break;
+			current_ = (current_ + chars_.size() - 1) % chars_.size();
+			Jump(fl, selected);
+			break;
+		case InputManager::DOWN:
+			if (chars_.empty()) break;
+			current_ = (current_ + 1) % chars_.size();
+			Jump(fl, selected);
+			break;
+		case InputManager::RIGHT: {
+			if (chars_.empty()) break;
+			const std::string longer = prefix_ + chars_[current_];
+			std::vector<std::string> next = fl.nextChars(longer);
+			if (next.empty()) break;
+			prefix_ = longer;
+			chars_ = std::move(next);
+			current_ = 0;
+			Jump(fl, selected);
+			break;
+		}
+		case InputManager::LEFT:
+			if (prefix_.empty()) {
+				open_ = false;
+				break;
+			}
+			Refresh(fl, PopChar(&prefix_));
+			Jump(fl, selected);
+			break;
+		case InputManager::CANCEL:
+			*selected = opened_selection_;
+			open_ = false;
+			break;
+		case InputManager::ACCEPT:
+		case InputManager::MENU:
+		case InputManager::SETTINGS:
+			open_ = false;
+			break;
+		default:
+			break;
+	}
+}
+
+void JumpBar::Refresh(const FileLister &fl, const std::string &current) {
+	chars_ = fl.nextChars(prefix_);
+	current_ = std::lower_bound(chars_.begin(), chars_.end(), current) -
+	           chars_.begin();
+	if (current_ >= chars_.size() && current_ > 0) current_ = chars_.size() - 1;
+}
+
+void JumpBar::Jump(const FileLister &fl, unsigned int *selected) {
+	if (chars_.empty()) return;
+	const int index = fl.findPrefix(prefix_ + chars_[current_]);
+	if (index >= 0) *selected = index;
+}
+
+void JumpBar::Paint(Surface &s) {
+	if (!open_) return;
+
+	const FontStack &font = *gmenu2x_.font;
+	unsigned int top, height;
+	std::tie(top, height) = gmenu2x_.getContentArea();
+	const int box_height = font.getLineSpacing() + 8;
+	const int y = top + height - box_height - 2;
+	const int text_y = y + box_height / 2;
+
+	s.box(10, y, gmenu2x_.width() - 20, box_height,
+	      gmenu2x_.skinConfColors[COLOR_MESSAGE_BOX_BG]);
+	s.rectangle(12, y + 2, gmenu2x_.width() - 24, box_height - 4,
+	            gmenu2x_.skinConfColors[COLOR_MESSAGE_BOX_BORDER]);
+
+	int x = 18;
+	x += font.write(s, prefix_, x, text_y, Font::HAlignLeft,
+	                Font::VAlignMiddle);
+	const int right = gmenu2x_.width() - 16;
+	for (std::size_t i = current_ >= kCharsBefore ? current_ - kCharsBefore : 0;
+	     i < chars_.size(); ++i) {
+		const int width = font.getTextWidth(chars_[i]) + 4;
+		if (x + width > right) break;
+		if (i == current_) {
+			s.box(x, y + 4, width, box_height - 8,
+			      gmenu2x_.skinConfColors[COLOR_MESSAGE_BOX_SELECTION]);
+		}
+		font.write(s, chars_[i], x + 2, text_y, Font::HAlignLeft,
+		           Font::VAlignMiddle);
+		x += width + 2;
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef _JUMP_BAR_H_
+#define _JUMP_BAR_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "inputmanager.h"
+
+class FileLister;
+class GMenu2X;
+class Surface;
+
+// Type-ahead for file lists: the name of the entry to go to is spelled one
+// character at a time, choosing among the characters that actually follow in
+// the list, and the selection moves along to the first match.
+//
+// Matches are found by binary search in the sorted list, so any entry of a
+// huge directory is a few presses away and nothing is scanned.
+//
+// While open, UP and DOWN change the last character, RIGHT adds a character
+// and LEFT removes one. ACCEPT closes the bar; CANCEL also restores the
+// selection it was opened with.
+class JumpBar {
+ public:
+	explicit JumpBar(GMenu2X &gmenu2x);
+
+	bool is_open() const { return open_; }
+
+	// Opens the bar, starting at the first character of the selected entry.
+	void Open(const FileLister &fl, unsigned int *selected);
+
+	// Handles a button press while the bar is open.
+	void HandleButton(InputManager::Button button, const FileLister &fl,
+	                  unsigned int *selected);
+
+	void Paint(Surface &s);
+
+ private:
+	// Looks up the characters that can follow prefix_, keeping `current` as
+	// the current one if it still occurs.
+	void Refresh(const FileLister &fl, const std::string &current);
+	void Jump(const FileLister &fl, unsigned int *selected);
+
+	GMenu2X &gmenu2x_;
+	bool open_ = false;
+	std::string prefix_;  // excluding the current character
+	std::vector<std::string> chars_;
+	std::size_t current_ = 0;
+	unsigned int opened_selection_ = 0;
+};
+
+#endif  // _JUMP_BAR_H_
@@ -0,0 +1,549 @@
+#include "library_index.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef ENABLE_INOTIFY
+#include <sys/inotify.h>
+#endif
+
+#include "compat-filesystem.h"
+#include "debug.h"
+#include "dir_listing_cache.h"
+#include "gmenu2x.h"
+#include "utilities.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'G', '2', 'X', 'L'};
+constexpr std::uint32_t kVersion = 2;
+constexpr char kManifestHeader[] = "G2XL manifest 1";
+
+// Limits for crawling, in case a selector directory is the root of a huge
+// tree.
+constexpr int kMaxDepth = 8;
+constexpr std::size_t kMaxWatches = 2048;
+
+// Number of directories the crawler reads between saving its progress.
+constexpr unsigned int kCheckpointInterval = 64;
+
+// A changed directory is read again once it has not changed for this long,
+// so that copying a batch of files causes a single read.
+constexpr auto kSettleTime = std::chrono::milliseconds(500);
+
+struct Header {
+	char magic[4];  // "G2XL"
+	std::uint32_t version;
+	// Of the directory, from before it was read.
+	std::int64_t mtime_sec;
+	std::int64_t mtime_nsec;
+	std::uint32_t path_length;
+	std::uint32_t directories, files;
+	std::uint32_t names_size;
+	// Followed by the path, then by the names of the directories and of the
+	// files, each terminated by '\0'.
+};
+
+std::string NormalizePath(const std::string &path) {
+	std::string result = path;
+	while (result.size() > 1 && result.back() == '/') result.pop_back();
+	return result;
+}
+
+bool IsUnder(const std::string &path, const std::string &root) {
+	if (path.compare(0, root.size(), root) != 0) return false;
+	return path.size() == root.size() || root == "/" || path[root.size()] == '/';
+}
+
+bool SameTime(const struct timespec &a, const struct timespec &b) {
+	return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+bool ReadFile(const std::string &path, std::string *data) {
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return false;
+	struct stat st;
+	bool ok = fstat(fd, &st) == 0;
+	if (ok) {
+		data->resize(st.st_size);
+		std::size_t done = 0;
+		while (ok && done < data->size()) {
+			const ssize_t n = read(fd, &(*data)[done], data->size() - done);
+			ok = n > 0;
+			if (ok) done += n;
+		}
+	}
+	close(fd);
+	return ok;
+}
+
+// Keeps the crawler from competing with the menu for the CPU and the card.
+void LowerPriority() {
+	const pid_t tid = syscall(SYS_gettid);
+	setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+	constexpr int kIoprioWhoProcess = 1;
+	constexpr int kIoprioClassIdle = 3;
+	syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, kIoprioClassIdle << 13);
+#endif
+}
+
+}  // namespace
+
+LibraryIndex &LibraryIndex::instance() {
+	static LibraryIndex index;
+	return index;
+}
+
+LibraryIndex::LibraryIndex()
+    : dir_(GMenu2X::getHome() + "/cache/library") {
+	wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_fd_ < 0) ERROR("Unable to create eventfd: %s\n", strerror(errno));
+}
+
+LibraryIndex::~LibraryIndex() {
+	if (thread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		Wake();
+		thread_.join();
+	}
+	if (wake_fd_ >= 0) close(wake_fd_);
+}
+
+void LibraryIndex::SetRoots(std::vector<std::string> roots) {
+	if (wake_fd_ < 0) return;
+	for (std::string &root : roots) root = NormalizePath(root);
+	std::sort(roots.begin(), roots.end());
+	roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (roots == roots_ && thread_.joinable()) return;
+	roots_ = std::move(roots);
+	roots_changed_ = true;
+	if (thread_.joinable()) {
+		Wake();
+	} else {
+		thread_ = std::thread(&LibraryIndex::Run, this);
+	}
+}
+
+// mutex_ must be held.
+bool LibraryIndex::IsCovered(const std::string &path) const {
+	for (const std::string &root : roots_) {
+		if (IsUnder(path, root)) return true;
+	}
+	return false;
+}
+
+std::string LibraryIndex::FileName(const std::string &path) const {
+	// FNV-1a; collisions are caught by the path stored in the file.
+	std::uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : path) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	char name[18];
+	snprintf(name, sizeof(name), "/%016llx",
+	         static_cast<unsigned long long>(hash));
+	return dir_ + name;
+}
+
+std::shared_ptr<const DirListing> LibraryIndex::Load(const std::string &path,
+                                                     const struct stat &st) {
+	const std::string key = NormalizePath(path);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!IsCovered(key)) return nullptr;
+		for (auto it = stores_.rbegin(); it != stores_.rend(); ++it) {
+			if (it->path == key) {
+				return SameTime(it->mtime, st.st_mtim) ? it->listing : nullptr;
+			}
+		}
+	}
+
+	std::string data;
+	if (!ReadFile(FileName(key), &data) || data.size() < sizeof(Header))
+		return nullptr;
+	Header header;
+	memcpy(&header, data.data(), sizeof(header));
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+	    header.version != kVersion || header.mtime_sec != st.st_mtim.tv_sec ||
+	    header.mtime_nsec != st.st_mtim.tv_nsec ||
+	    header.path_length != key.size() ||
+	    data.size() != sizeof(Header) + header.path_length + header.names_size ||
+	    data.compare(sizeof(Header), key.size(), key) != 0) {
+		return nullptr;
+	}
+
+	auto listing = std::make_shared<DirListing>();
+	const char *p = data.data() + sizeof(Header) + header.path_length;
+	const char *end = data.data() + data.size();
+	const std::uint64_t count =
+	    static_cast<std::uint64_t>(header.directories) + header.files;
+	for (std::uint64_t i = 0; i < count; ++i) {
+		const char *nul = static_cast<const char *>(memchr(p, '\0', end - p));
+		if (!nul) return nullptr;
+		NameList &names =
+		    i < header.directories ? listing->directories : listing->files;
+		names.Add(compat::string_view(p, nul - p));
+		p = nul + 1;
+	}
+	if (p != end) return nullptr;
+	return listing;
+}
+
+void LibraryIndex::Store(const std::string &path, const struct stat &st,
+                         std::shared_ptr<const DirListing> listing) {
+	const std::string key = NormalizePath(path);
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!thread_.joinable() || !IsCovered(key)) return;
+	stores_.push_back(PendingStore{key, st.st_mtim, std::move(listing)});
+	Wake();
+}
+
+void LibraryIndex::Wake() {
+	const std::uint64_t one = 1;
+	// Only fails if the counter is about to overflow, which wakes it anyway.
+	if (write(wake_fd_, &one, sizeof(one)) < 0) return;
+}
+
+void LibraryIndex::Write(const std::string &path,
+                         const struct timespec &mtime,
+                         const DirListing &listing) {
+	Header header;
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.mtime_sec = mtime.tv_sec;
+	header.mtime_nsec = mtime.tv_nsec;
+	header.path_length = path.size();
+	header.directories = listing.directories.size();
+	header.files = listing.files.size();
+
+	std::string names;
+	for (const NameList *list : {&listing.directories, &listing.files}) {
+		for (std::size_t i = 0; i < list->size(); ++i) {
+			const compat::string_view name = (*list)[i];
+			names.append(name.data(), name.size());
+			names += '\0';
+		}
+	}
+	header.names_size = names.size();
+
+	std::string data(reinterpret_cast<const char *>(&header), sizeof(header));
+	data += path;
+	data += names;
+	// Not synced: a listing that is cut short by a crash fails the size
+	// check when it is read, and the directory is read again.
+	if (!writeStringToFile(FileName(path), data, false)) {
+		WARNING("Unable to store the listing of '%s'\n", path.c_str());
+	}
+}
+
+void LibraryIndex::Run() {
+	LowerPriority();
+	std::error_code ec;
+	compat::filesystem::create_directories(dir_, ec);
+	if (ec) {
+		ERROR("Unable to create library directory '%s': %s\n", dir_.c_str(),
+		      ec.message().c_str());
+	}
+#ifdef ENABLE_INOTIFY
+	inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd_ < 0)
+		WARNING("Unable to start inotify for the library\n");
+#endif
+	LoadManifest();
+
+	for (;;) {
+		std::vector<std::string> roots;
+		bool roots_changed;
+		std::vector<PendingStore> stores;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (stop_) break;
+			roots_changed = roots_changed_;
+			roots_changed_ = false;
+			if (roots_changed) roots = roots_;
+			stores.swap(stores_);
+		}
+		for (const PendingStore &store : stores)
+			Write(store.path, store.mtime, *store.listing);
+		if (roots_changed) ApplyRoots(roots);
+
+		// Handle one directory per iteration, so that stores and a stop are
+		// not held up by a long crawl.
+		const auto now = std::chrono::steady_clock::now();
+		int timeout = -1;
+		auto settled = std::find_if(
+		    changed_.begin(), changed_.end(),
+		    [now](const std::pair<const std::string,
+		                          std::chrono::steady_clock::time_point> &entry) {
+			    return entry.second <= now;
+		    });
+		if (settled != changed_.end()) {
+			const std::string path = settled->first;
+			changed_.erase(settled);
+			auto it = dirs_.find(path);
+			if (it != dirs_.end()) Visit(path, it->second.depth, true);
+			timeout = 0;
+		} else if (!unverified_.empty()) {
+			const std::string path = std::move(unverified_.front());
+			unverified_.pop_front();
+			Verify(path);
+			timeout = 0;
+		} else if (!queue_.empty()) {
+			const auto entry = std::move(queue_.front());
+			queue_.pop_front();
+			Visit(entry.first, entry.second, false);
+			timeout = 0;
+		} else {
+			if (manifest_dirty_) SaveManifest();
+			for (const auto &entry : changed_) {
+				const int wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+				                     entry.second - now).count() + 1;
+				if (timeout < 0 || wait < timeout) timeout = wait;
+			}
+		}
+		if (visits_since_save_ >= kCheckpointInterval) SaveManifest();
+
+		struct pollfd fds[2] = {{wake_fd_, POLLIN, 0}, {inotify_fd_, POLLIN, 0}};
+		if (poll(fds, inotify_fd_ >= 0 ? 2 : 1, timeout) > 0) {
+			std::uint64_t count;
+			if ((fds[0].revents & POLLIN) &&
+			    read(wake_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+				ERROR("Unable to read eventfd: %s\n", strerror(errno));
+			}
+			ProcessEvents();
+		}
+	}
+
+	if (manifest_dirty_) SaveManifest();
+#ifdef ENABLE_INOTIFY
+	if (inotify_fd_ >= 0) close(inotify_fd_);
+	inotify_fd_ = -1;
+#endif
+}
+
+void LibraryIndex::ApplyRoots(const std::vector<std::string> &roots) {
+	auto covered = [&roots](const std::string &path) {
+		for (const std::string &root : roots) {
+			if (IsUnder(path, root)) return true;
+		}
+		return false;
+	};
+
+	std::vector<std::string> dropped;
+	for (const auto &dir : dirs_) {
+		if (!covered(dir.first)) dropped.push_back(dir.first);
+	}
+	for (const std::string &path : dropped) Drop(path);
+	queue_.erase(std::remove_if(queue_.begin(), queue_.end(),
+	                            [&covered](const std::pair<std::string, int> &e) {
+		                            return !covered(e.first);
+	                            }),
+	             queue_.end());
+
+	for (const std::string &root : roots) {
+		const bool queued = std::any_of(
+		    queue_.begin(), queue_.end(),
+		    [&root](const std::pair<std::string, int> &e) {
+			    return e.first == root;
+		    });
+		if (!queued && !dirs_.count(root)) queue_.emplace_back(root, 0);
+	}
+	manifest_dirty_ = true;
+}
+
+void LibraryIndex::Visit(const std::string &path, int depth, bool reread) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+		Drop(path);
+		return;
+	}
+
+	std::shared_ptr<const DirListing> listing;
+	if (!reread) listing = Load(path, st);
+	if (!listing) {
+		auto read = std::make_shared<DirListing>();
+		if (!ReadDirListing(path, read.get())) {
+			Drop(path);
+			return;
+		}
+		Write(path, st.st_mtim, *read);
+		listing = std::move(read);
+	}
+
+	auto result = dirs_.emplace(path, Dir{st.st_mtim, depth, -1});
+	result.first->second.mtime = st.st_mtim;
+	Watch(path, &result.first->second);
+	manifest_dirty_ = true;
+	++visits_since_save_;
+
+	if (depth >= kMaxDepth) return;
+	const NameList &subdirs = listing->directories;
+	for (std::size_t i = 0; i < subdirs.size(); ++i) {
+		const compat::string_view name = subdirs[i];
+		// The manifest has a path per line.
+		if (name == ".." || name.find('\n') != compat::string_view::npos)
+			continue;
+		std::string child = path == "/" ? path : path + '/';
+		child.append(name.data(), name.size());
+		// Directories that were read before are watched themselves.
+		if (!dirs_.count(child)) queue_.emplace_back(std::move(child), depth + 1);
+	}
+}
+
+void LibraryIndex::Verify(const std::string &path) {
+	auto it = dirs_.find(path);
+	if (it == dirs_.end()) return;
+
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+		Drop(path);
+	} else if (!SameTime(st.st_mtim, it->second.mtime)) {
+		Visit(path, it->second.depth, true);
+	} else {
+		Watch(path, &it->second);
+	}
+}
+
+void LibraryIndex::Drop(const std::string &path) {
+	auto it = dirs_.find(path);
+	if (it != dirs_.end()) {
+#ifdef ENABLE_INOTIFY
+		if (it->second.watch >= 0) {
+			inotify_rm_watch(inotify_fd_, it->second.watch);
+			watches_.erase(it->second.watch);
+		}
+#endif
+		dirs_.erase(it);
+		manifest_dirty_ = true;
+	}
+	unlink(FileName(path).c_str());
+}
+
+void LibraryIndex::Watch(const std::string &path, Dir *dir) {
+#ifdef ENABLE_INOTIFY
+	if (dir->watch >= 0 || inotify_fd_ < 0 || watches_.size() >= kMaxWatches)
+		return;
+	const int watch = inotify_add_watch(
+	    inotify_fd_, path.c_str(),
+	    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+	        IN_MOVE_SELF | IN_ONLYDIR);
+	// Another path to the same directory may own the watch already.
+	if (watch >= 0 && watches_.emplace(watch, path).second) dir->watch = watch;
+#else
+	(void)path;
+	(void)dir;
+#endif
+}
+
+void LibraryIndex::ProcessEvents() {
+#ifdef ENABLE_INOTIFY
+	if (inotify_fd_ < 0) return;
+	alignas(struct inotify_event) char buf[4096];
+	const auto settled = std::chrono::steady_clock::now() + kSettleTime;
+	for (;;) {
+		const ssize_t len = read(inotify_fd_, buf, sizeof(buf));
+		if (len <= 0) break;
+		for (ssize_t i = 0; i < len;) {
+			const auto *event =
+			    reinterpret_cast<const struct inotify_event *>(buf + i);
+			i += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				// Events were lost; compare every directory.
+				for (const auto &dir : dirs_) unverified_.push_back(dir.first);
+				continue;
+			}
+			auto it = watches_.find(event->wd);
+			if (it == watches_.end()) continue;
+			const std::string path = it->second;
+			if (event->mask & IN_IGNORED) {
+				// The kernel drops the watch by itself.
+				watches_.erase(it);
+				auto dir = dirs_.find(path);
+				if (dir != dirs_.end()) dir->second.watch = -1;
+			}
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+				unverified_.push_back(path);
+			} else {
+				changed_[path] = settled;
+			}
+		}
+	}
+#endif
+}
+
+void LibraryIndex::LoadManifest() {
+	std::ifstream in(dir_ + "/manifest");
+	std::string line;
+	if (!std::getline(in, line) || line != kManifestHeader) return;
+
+	while (std::getline(in, line)) {
+		int depth, n = 0;
+		if (line.compare(0, 2, "D ") == 0) {
+			long long sec;
+			long nsec;
+			if (sscanf(line.c_str() + 2, "%lld %ld %d %n", &sec, &nsec, &depth,
+			           &n) != 3 || n == 0) {
+				continue;
+			}
+			Dir dir;
+			dir.mtime.tv_sec = sec;
+			dir.mtime.tv_nsec = nsec;
+			dir.depth = depth;
+			dir.watch = -1;
+			const std::string path = line.substr(2 + n);
+			dirs_.emplace(path, dir);
+			unverified_.push_back(path);
+		} else if (line.compare(0, 2, "P ") == 0) {
+			if (sscanf(line.c_str() + 2, "%d %n", &depth, &n) != 1 || n == 0)
+				continue;
+			queue_.emplace_back(line.substr(2 + n), depth);
+		}
+	}
+	DEBUG("Library manifest: %zu directories read, %zu to go\n", dirs_.size(),
+	      queue_.size());
+}
+
+void LibraryIndex::SaveManifest() {
+	std::string data = kManifestHeader;
+	data += '\n';
+	char buf[64];
+	for (const auto &dir : dirs_) {
+		snprintf(buf, sizeof(buf), "D %lld %ld %d ",
+		         static_cast<long long>(dir.second.mtime.tv_sec),
+		         static_cast<long>(dir.second.mtime.tv_nsec), dir.second.depth);
+		data += buf;
+		data += dir.first;
+		data += '\n';
+	}
+	for (const auto &entry : queue_) {
+		snprintf(buf, sizeof(buf), "P %d ", entry.second);
+		data += buf;
+		data += entry.first;
+		data += '\n';
+	}
+	// Not synced either: a manifest that is cut short by a crash fails its
+	// header check or loses its last lines, and the crawl redoes the
+	// directories they described.
+	if (!writeStringToFile(dir_ + "/manifest", data, false)) {
+		WARNING("Unable to save the library manifest\n");
+	}
+	manifest_dirty_ = false;
+	visits_since_save_ = 0;
+}
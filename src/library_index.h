@@ -0,0 +1,114 @@
+#ifndef _LIBRARY_INDEX_H_
+#define _LIBRARY_INDEX_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+struct DirListing;
+
+// A persistent store of the listings of the directories that selectors show,
+// so that a deep ROM tree on a slow card opens without being read again.
+//
+// The listing of every directory under the library roots is kept in a file
+// of its own under ~/.gmenu2x/cache/library, together with the modification
+// time the directory had when it was read; a listing is only used while the
+// directory still has that time. The previews of a selector are listed like
+// any other subdirectory.
+//
+// A background thread with the lowest CPU and I/O priority crawls the roots.
+// It records its progress in a manifest, so that an interrupted crawl
+// resumes where it stopped and a finished one only has to compare
+// modification times at the next start. With inotify, it also reads
+// directories again when they change while it runs.
+//
+// May be used from any thread.
+class LibraryIndex {
+ public:
+	static LibraryIndex &instance();
+
+	LibraryIndex(const LibraryIndex &) = delete;
+	LibraryIndex &operator=(const LibraryIndex &) = delete;
+
+	// Stops the crawler, saving its progress.
+	~LibraryIndex();
+
+	// Sets the directories that are kept in the library along with their
+	// subdirectories, and starts crawling them in the background.
+	void SetRoots(std::vector<std::string> roots);
+
+	// Returns the stored listing of the given directory, which currently has
+	// the status `st`, or nullptr if there is none or it is out of date.
+	std::shared_ptr<const DirListing> Load(const std::string &path,
+	                                       const struct stat &st);
+
+	// Stores the listing of a directory that had the status `st` before it
+	// was read, if the directory is in the library. The file is written by
+	// the background thread.
+	void Store(const std::string &path, const struct stat &st,
+	           std::shared_ptr<const DirListing> listing);
+
+ private:
+	struct PendingStore {
+		std::string path;
+		struct timespec mtime;
+		std::shared_ptr<const DirListing> listing;
+	};
+
+	// A directory the crawler has read; only used by the crawler thread.
+	struct Dir {
+		struct timespec mtime;
+		int depth;
+		int watch;
+	};
+
+	LibraryIndex();
+
+	bool IsCovered(const std::string &path) const;
+	std::string FileName(const std::string &path) const;
+	void Write(const std::string &path, const struct timespec &mtime,
+	           const DirListing &listing);
+
+	void Wake();
+	void Run();
+	void ApplyRoots(const std::vector<std::string> &roots);
+	void Visit(const std::string &path, int depth, bool reread);
+	void Verify(const std::string &path);
+	void Drop(const std::string &path);
+	void Watch(const std::string &path, Dir *dir);
+	void ProcessEvents();
+	void LoadManifest();
+	void SaveManifest();
+
+	const std::string dir_;
+
+	mutable std::mutex mutex_;
+	std::vector<std::string> roots_;
+	bool roots_changed_ = false;
+	std::vector<PendingStore> stores_;
+	bool stop_ = false;
+	int wake_fd_ = -1;
+	std::thread thread_;
+
+	// Crawler state.
+	std::map<std::string, Dir> dirs_;
+	std::deque<std::pair<std::string, int>> queue_;  // path and depth
+	std::deque<std::string> unverified_;
+	std::map<std::string, std::chrono::steady_clock::time_point> changed_;
+	std::unordered_map<int, std::string> watches_;
+	int inotify_fd_ = -1;
+	unsigned int visits_since_save_ = 0;
+	bool manifest_dirty_ = false;
+};
+
+#endif  // _LIBRARY_INDEX_H_
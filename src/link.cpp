@@ -20,6 +20,7 @@
 
 #include "link.h"
 
+#include "collation.h"
 #include "gmenu2x.h"
 #include "menu.h"
 #include "selector.h"
@@ -31,18 +32,19 @@
 
 using namespace std;
 
+static unsigned int lastRevision = 0;
 
-Link::Link(GMenu2X& gmenu2x, Action action)
+
+Link::Link(GMenu2X& gmenu2x, Action action, Kind kind)
 	: gmenu2x(gmenu2x)
 	, action(action)
+	, kind(kind)
 	, iconPath(gmenu2x.sc.getSkinFilePath("icons/generic.png"))
 	, edited(false)
-	, rect {
-		0, 0,
-		static_cast<decltype(SDL_Rect().w)>(gmenu2x.skinConfInt["linkWidth"]),
-		static_cast<decltype(SDL_Rect().h)>(gmenu2x.skinConfInt["linkHeight"])
-	}
+	, sortLast(false)
+	, revision(0)
 {
+	updateSortKey();
 	updateSurfaces();
 }
 
@@ -57,6 +59,7 @@ void Link::updateTitleSurface() {
 	} else {
 		titleSurface = nullptr;
 	}
+	revision = ++lastRevision;
 }
 
 void Link::updateDescriptionSurface() {
@@ -67,31 +70,6 @@ void Link::updateDescriptionSurface() {
 	}
 }
 
-void Link::paint() {
-	Surface& s = *gmenu2x.s;
-
-	if (iconSurface) {
-		iconSurface->blit(s, iconX, rect.y+padding, 32,32);
-	}
-
-	SDL_Rect coords = {
-		static_cast<Sint16>(iconX + 16),
-		static_cast<Sint16>(rect.y + gmenu2x.skinConfInt["linkHeight"] - padding),
-		0, 0
-	};
-
-	titleSurface->blit(s, coords, Font::HAlignCenter, Font::VAlignBottom);
-}
-
-void Link::paintHover() {
-	Surface& s = *gmenu2x.s;
-
-	if (gmenu2x.useSelectionPng)
-		gmenu2x.sc["imgs/selection.png"]->blit(s, rect, Font::HAlignCenter, Font::VAlignMiddle);
-	else
-		s.box(rect.x, rect.y, rect.w, rect.h, gmenu2x.skinConfColors[COLOR_SELECTION_BG]);
-}
-
 void Link::paintDescription(int center_x, int center_y)
 {
 	SDL_Rect coords = {
@@ -109,6 +87,7 @@ void Link::paintDescription(int center_x, int center_y)
 void Link::updateSurfaces()
 {
 	iconSurface = gmenu2x.sc[getIconPath()];
+	revision = ++lastRevision;
 }
 
 const string &Link::getTitle() const {
@@ -117,10 +96,25 @@ const string &Link::getTitle() const {
 
 void Link::setTitle(const string &title) {
 	this->title = title;
+	updateSortKey();
 	updateTitleSurface();
 	edited = true;
 }
 
+const string &Link::getSortKey() const {
+	return sortKey;
+}
+
+void Link::setSortLast() {
+	sortLast = true;
+	updateSortKey();
+}
+
+void Link::updateSortKey() {
+	sortKey.assign(1, sortLast ? '\1' : '\0');
+	AppendCollationKey(title, &sortKey);
+}
+
 const string &Link::getDescription() const {
 	return description;
 }
@@ -176,23 +170,6 @@ void Link::setIconPath(const string &icon) {
 	updateSurfaces();
 }
 
-void Link::setSize(int w, int h) {
-	rect.w = w;
-	rect.h = h;
-	recalcCoordinates();
-}
-
-void Link::setPosition(int x, int y) {
-	rect.x = x;
-	rect.y = y;
-	recalcCoordinates();
-}
-
-void Link::recalcCoordinates() {
-	iconX = rect.x+(rect.w-32)/2;
-	padding = (gmenu2x.skinConfInt["linkHeight"] - 32 - gmenu2x.font->getLineSpacing()) / 3;
-}
-
 void Link::run() {
 	this->action();
 }
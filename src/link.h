@@ -40,20 +40,38 @@ class Link {
 public:
 	typedef std::function<void(void)> Action;
 
-	Link(GMenu2X& gmenu2x, Action action);
+	/**
+	 * The concrete class of a link, so that callers can tell links apart
+	 * without a dynamic_cast.
+	 */
+	enum class Kind { ACTION, APP };
+
+	Link(GMenu2X& gmenu2x, Action action, Kind kind = Kind::ACTION);
 	virtual ~Link() {};
 
-	virtual void paint();
-	void paintHover();
+	Kind getKind() const { return kind; }
+
 	void paintDescription(int center_x, int center_y);
 
 	virtual void loadIcon();
 
-	void setSize(int w, int h);
-	void setPosition(int x, int y);
+	/** The icon drawn in the menu, or NULL if there is none. */
+	OffscreenSurface *getIconSurface() const { return iconSurface; }
+	/** The title drawn in the menu, or NULL if it is empty. */
+	OffscreenSurface *getTitleSurface() const { return titleSurface.get(); }
+	/**
+	 * Changes whenever the icon or title surface does; no two links
+	 * ever share a revision.
+	 */
+	unsigned int getRevision() const { return revision; }
 
 	const std::string &getTitle() const;
 	void setTitle(const std::string &title);
+	/**
+	 * Links are ordered by this key: the collation key of the title, with
+	 * the links put after the others by setSortLast() at the end.
+	 */
+	const std::string &getSortKey() const;
 	const std::string &getDescription() const;
 	void setDescription(const std::string &description);
 	const std::string &getLaunchMsg();
@@ -77,18 +95,19 @@ protected:
 	virtual const std::string &searchIcon();
 	void setIconPath(const std::string &icon);
 	void updateSurfaces();
+	void setSortLast();
 
 private:
-	void recalcCoordinates();
 	void updateTitleSurface();
 	void updateDescriptionSurface();
+	void updateSortKey();
 
 	Action action;
-
-	SDL_Rect rect;
-	uint32_t iconX, padding;
-	int lastTick;
+	const Kind kind;
 	std::string title, description;
+	std::string sortKey;
+	bool sortLast;
+	unsigned int revision;
 };
 
 #endif
@@ -84,7 +84,7 @@ LinkApp::LinkApp(GMenu2X& gmenu2x, string const& linkfile, bool deletable,
 #else
 LinkApp::LinkApp(GMenu2X& gmenu2x, string const& linkfile, bool deletable)
 #endif
-	: Link(gmenu2x, bind(&LinkApp::start, this))
+	: Link(gmenu2x, bind(&LinkApp::start, this), Kind::APP)
 	, deletable(deletable)
 {
 	manual = "";
@@ -106,6 +106,9 @@ LinkApp::LinkApp(GMenu2X& gmenu2x, string const& linkfile, bool deletable)
 	isOPK = !!opk;
 
 	if (isOPK) {
+		// Packages are listed after the links of the section.
+		setSortLast();
+
 		string::size_type pos;
 		const char *key, *val;
 		size_t lkey, lval;
@@ -395,7 +398,7 @@ void LinkApp::drawLaunch(Surface& s) {
 
 void LinkApp::start() {
 	if (selectordir.empty()) {
-		gmenu2x.queueLaunch(prepareLaunch(""), make_shared<LaunchLayer>(*this));
+		launch();
 	} else {
 		selector();
 	}
@@ -544,12 +547,15 @@ void LinkApp::selector(int startSelection, const string &selectorDir) {
 			selectordir = selectedDir;
 		}
 		gmenu2x.writeTmp(selection, selectedDir);
-		gmenu2x.queueLaunch(
-				prepareLaunch(selectedDir + sel.getFile()),
-				make_shared<LaunchLayer>(*this));
+		launch(selectedDir + sel.getFile());
 	}
 }
 
+void LinkApp::launch(const string &selectedFile) {
+	gmenu2x.queueLaunch(
+			prepareLaunch(selectedFile), make_shared<LaunchLayer>(*this));
+}
+
 unique_ptr<Launcher> LinkApp::prepareLaunch(const string &selectedFile) {
 	if (!save()) {
 		ERROR("Error saving app settings to '%s'.\n", file.c_str());
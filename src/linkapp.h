@@ -55,6 +55,15 @@ protected:
 	virtual const std::string &searchIcon();
 
 public:
+	/**
+	 * @return The given link as a LinkApp, or NULL if it is another kind
+	 *         of link.
+	 */
+	static LinkApp *from(Link *link) {
+		return link && link->getKind() == Kind::APP
+				? static_cast<LinkApp *>(link) : nullptr;
+	}
+
 #ifdef HAVE_LIBOPK
 	const std::string &getCategory() { return category; }
 	bool isOpk() { return isOPK; }
@@ -86,7 +95,10 @@ public:
 	bool save();
 	void showManual();
 	void selector(int startSelection=0, const std::string &selectorDir="");
+	void launch(const std::string &selectedFile = "");
 	bool targetExists();
+	// The path that targetExists() checks.
+	const std::string &getTarget() { return exec; }
 	bool isDeletable() { return deletable; }
 	bool isEditable() { return editable; }
 
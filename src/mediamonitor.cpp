@@ -3,16 +3,19 @@
 
 #include <sys/inotify.h>
 #include <SDL/SDL.h>
-#include <unistd.h>
 
 #include "debug.h"
 #include "inputmanager.h"
 #include "mediamonitor.h"
 #include "menu.h"
+#include "mount_watcher.h"
 #include "utilities.h"
 
 using namespace std;
 
+/* Longest time to wait for a new mountpoint to get mounted */
+static const int MOUNT_TIMEOUT_MS = 5000;
+
 MediaMonitor::MediaMonitor(string dir, Menu *menu) :
 	Monitor(dir, menu, IN_MOVE | IN_DELETE | IN_CREATE | IN_ONLYDIR)
 {
@@ -26,16 +29,20 @@ bool MediaMonitor::event_accepted(
 
 void MediaMonitor::inject_event(bool is_add, const char *path)
 {
-	/* Sleep for a bit, to ensure that the media will be mounted
-	 * on the mountpoint before we start looking for OPKs */
-	sleep(1);
-
-	if (is_add)
-		menu->openPackagesFromDir(((string)path + "/apps").c_str());
-	else
-		menu->removePackageLink(path);
-
-	request_repaint();
+	if (is_add) {
+		/* Wait for the media to be mounted on the mountpoint
+		 * before we start looking for OPKs */
+		MountWatcher mounts;
+		if (!mounts.WaitFor(path, MOUNT_TIMEOUT_MS))
+			WARNING("Nothing was mounted on %s\n", path);
+
+		menu->queuePackageEvent(Menu::PackageEvent::DIRECTORY_ADDED,
+					(string) path + "/apps");
+		/* Don't wait for more events: a card is inserted on its own */
+		request_repaint();
+	} else {
+		menu->queuePackageEvent(Menu::PackageEvent::REMOVED, path);
+	}
 }
 
 #endif /* ENABLE_INOTIFY */
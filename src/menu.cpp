@@ -22,13 +22,17 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <algorithm>
+#include <atomic>
 #include <math.h>
 #include <fstream>
+#include <iterator>
+#include <set>
 #include <unistd.h>
 #include <cassert>
 #include <cerrno>
 #include <cstring>
 #include <system_error>
+#include <thread>
 
 #include "compat-filesystem.h"
 
@@ -41,6 +45,8 @@
 #include "linkapp.h"
 #include "menu.h"
 #include "monitor.h"
+#include "opk_icon_cache.h"
+#include "parallel_sort.h"
 #include "filelister.h"
 #include "utilities.h"
 #include "debug.h"
@@ -75,13 +81,13 @@ Menu::Menu(GMenu2X& gmenu2x)
 	: gmenu2x(gmenu2x)
 	, btnContextMenu(gmenu2x, "skin:imgs/menu.png", "",
 			std::bind(&GMenu2X::showContextMenu, &gmenu2x))
+	, iSection(0)
+	, iLink(0)
+	, iFirstDispRow(0)
 {
 	readSections(GMENU2X_SYSTEM_DIR "/sections");
 	readSections(GMenu2X::getHome() + "/sections");
 
-	setSectionIndex(0);
-	readLinks();
-
 #ifdef HAVE_LIBOPK
 	{
 		DIR *dirp = opendir(GMENU2X_CARD_ROOT);
@@ -104,8 +110,6 @@ Menu::Menu(GMenu2X& gmenu2x)
 
 	btnContextMenu.setPosition(gmenu2x.width() - 38,
 				   gmenu2x.bottomBarIconY);
-
-	updateSectionTextSurfaces();
 }
 
 Menu::~Menu()
@@ -114,14 +118,59 @@ Menu::~Menu()
 
 void Menu::readSections(std::string const& parentDir)
 {
+	std::vector<std::string> names;
 	std::error_code ec;
 	for (const auto& entry : compat::filesystem::directory_iterator(parentDir, ec))
 	{
 		const auto filename = entry.path().filename().string();
 		if (filename[0] != '.')
-			sectionNamed(filename);
+			names.push_back(filename);
 	}
 	//TODO: report anything in case of error?
+	addSections(names);
+}
+
+void Menu::addSections(vector<string> names)
+{
+	sort(names.begin(), names.end());
+	names.erase(unique(names.begin(), names.end()), names.end());
+	vector<string> added;
+	set_difference(names.begin(), names.end(),
+			sections.begin(), sections.end(), back_inserter(added));
+	if (added.empty())
+		return;
+
+	// Merge the new sections in, keeping the same section selected.
+	const auto &font = *gmenu2x.font;
+	const size_t size = sections.size() + added.size();
+	vector<string> newSections;
+	vector<vector<unique_ptr<Link>>> newLinks;
+	vector<unique_ptr<OffscreenSurface>> newSurfaces;
+	newSections.reserve(size);
+	newLinks.reserve(size);
+	newSurfaces.reserve(size);
+	int selected = iSection;
+	for (size_t i = 0, j = 0; i < sections.size() || j < added.size(); ) {
+		if (j == added.size()
+				|| (i < sections.size() && sections[i] < added[j])) {
+			if ((int) i == iSection)
+				selected = newSections.size();
+			newSections.push_back(std::move(sections[i]));
+			newLinks.push_back(std::move(links[i]));
+			newSurfaces.push_back(std::move(section_text_surfaces[i]));
+			i++;
+		} else {
+			newSurfaces.push_back(font.render(added[j]));
+			newSections.push_back(std::move(added[j]));
+			newLinks.emplace_back();
+			j++;
+		}
+	}
+	sections = std::move(newSections);
+	links = std::move(newLinks);
+	section_text_surfaces = std::move(newSurfaces);
+	iSection = selected;
+	updateSectionHeaders();
 }
 
 string Menu::createSectionDir(string const& sectionName)
@@ -144,17 +193,12 @@ void Menu::skinUpdated() {
 	linkColumns = (gmenu2x.width() - 10) / skinConfInt["linkWidth"];
 	linkRows = (gmenu2x.height() - 35 - skinConfInt["topBarHeight"])
 		 / skinConfInt["linkHeight"];
+	updateGrid();
 
-	//reload section icons
-	decltype(links)::size_type i = 0;
-	for (auto& sectionName : sections) {
-		gmenu2x.sc["skin:sections/" + sectionName + ".png"];
-
-		for (auto& link : links[i]) {
+	for (auto& section_links : links) {
+		for (auto& link : section_links) {
 			link->loadIcon();
 		}
-
-		i++;
 	}
 }
 
@@ -163,6 +207,126 @@ void Menu::fontChanged() {
 		for (auto& link : section_links)
 			link->updateTextSurfaces();
 	updateSectionTextSurfaces();
+	updateGrid();
+}
+
+void Menu::updateGrid() {
+	ConfIntHash &skinConfInt = gmenu2x.skinConfInt;
+	const int width = gmenu2x.width(), height = gmenu2x.height();
+	grid.linkWidth = skinConfInt["linkWidth"];
+	grid.linkHeight = skinConfInt["linkHeight"];
+	grid.topBarHeight = skinConfInt["topBarHeight"];
+	grid.bottomBarHeight = skinConfInt["bottomBarHeight"];
+
+	const int linkSpacingX = (width - 10 - linkColumns * grid.linkWidth) / linkColumns;
+	const int linkMarginX = (
+			width - grid.linkWidth * linkColumns - linkSpacingX * (linkColumns - 1)
+			) / 2;
+	const int linkSpacingY = (height - 35 - grid.topBarHeight - linkRows * grid.linkHeight) / linkRows;
+	const int padding = (grid.linkHeight - 32 - gmenu2x.font->getLineSpacing()) / 3;
+
+	const uint32_t linksPerPage = linkColumns * linkRows;
+	for (auto *v : { &grid.x, &grid.y, &grid.iconX, &grid.iconY,
+			&grid.titleX, &grid.titleY }) {
+		v->resize(linksPerPage);
+	}
+	for (uint32_t i = 0; i < linksPerPage; i++) {
+		const int x = linkMarginX + (i % linkColumns) * (grid.linkWidth + linkSpacingX);
+		const int y = i / linkColumns * (grid.linkHeight + linkSpacingY) + grid.topBarHeight + 2;
+		grid.x[i] = x;
+		grid.y[i] = y;
+		grid.iconX[i] = x + (grid.linkWidth - 32) / 2;
+		grid.iconY[i] = y + padding;
+		grid.titleX[i] = grid.iconX[i] + 16;
+		grid.titleY[i] = y + grid.linkHeight - padding;
+	}
+
+	unsigned int pageY, pageHeight;
+	tie(pageY, pageHeight) = gmenu2x.getContentArea();
+	grid.pageY = pageY;
+	grid.pageHeight = pageHeight;
+	pages.clear();
+
+	SurfaceCollection &sc = gmenu2x.sc;
+	const bool hideLR = skinConfInt["hideLR"];
+	grid.lButton = hideLR ? nullptr : sc.skinRes("imgs/section-l.png");
+	grid.rButton = hideLR ? nullptr : sc.skinRes("imgs/section-r.png");
+	grid.selection = gmenu2x.useSelectionPng ? sc["imgs/selection.png"] : nullptr;
+	grid.manual = sc.skinRes("imgs/manual.png");
+	updateSectionHeaders();
+}
+
+void Menu::updateSectionHeaders() {
+	SurfaceCollection &sc = gmenu2x.sc;
+	grid.sectionIcons.resize(sections.size());
+	for (size_t i = 0; i < sections.size(); i++) {
+		OffscreenSurface *icon = sc["skin:sections/" + sections[i] + ".png"];
+		grid.sectionIcons[i] = icon ? icon : sc.skinRes("icons/section.png");
+	}
+
+	const int linkWidth = gmenu2x.skinConfInt["linkWidth"];
+	const int numSections = sections.size();
+	grid.rightSection = min(
+			max(1, ((int) gmenu2x.width() - 20 - linkWidth) / (2 * linkWidth)),
+			numSections / 2);
+	grid.leftSection = max(
+			-grid.rightSection,
+			grid.rightSection - numSections + 1);
+}
+
+void Menu::paintLink(Surface& s, Link const& link, uint32_t cell, int offsetY)
+{
+	if (auto icon = link.getIconSurface())
+		icon->blit(s, grid.iconX[cell], grid.iconY[cell] + offsetY, 32, 32);
+	if (auto title = link.getTitleSurface()) {
+		SDL_Rect coords = {
+			grid.titleX[cell], static_cast<Sint16>(grid.titleY[cell] + offsetY),
+			0, 0
+		};
+		title->blit(s, coords, Font::HAlignCenter, Font::VAlignBottom);
+	}
+}
+
+OffscreenSurface *Menu::sectionPage(int section)
+{
+	const auto& sectionLinks = links[section];
+	const uint32_t firstRow = section == iSection ? iFirstDispRow : 0;
+	const uint32_t first = firstRow * linkColumns;
+	const uint32_t count = sectionLinks.size() > first
+			? min<size_t>(sectionLinks.size() - first, grid.x.size()) : 0;
+	auto page = find_if(pages.begin(), pages.end(), [section](Page const& p) {
+		return p.section == section;
+	});
+	if (page == pages.end()) {
+		pages.push_back(Page { section, 0, {}, nullptr });
+		page = pages.end() - 1;
+	}
+
+	bool valid = page->surface && page->firstRow == firstRow
+			&& page->cells.size() == count;
+	for (uint32_t i = 0; valid && i < count; i++) {
+		const Link *link = sectionLinks[first + i].get();
+		valid = page->cells[i].first == link
+				&& page->cells[i].second == link->getRevision();
+	}
+	if (valid)
+		return page->surface.get();
+
+	page->firstRow = firstRow;
+	page->cells.clear();
+	page->surface = OffscreenSurface::emptySurface(
+			gmenu2x.width(), grid.pageHeight);
+	if (!page->surface)
+		return nullptr;
+
+	gmenu2x.bgmain->blit(*page->surface, 0, -grid.pageY);
+	for (uint32_t i = 0; i < count; i++) {
+		const Link &link = *sectionLinks[first + i];
+		paintLink(*page->surface, link, i, -grid.pageY);
+		page->cells.emplace_back(&link, link.getRevision());
+	}
+	page->surface->convertToDisplayFormat();
+	return page->surface.get();
 }
 
 void Menu::updateSectionTextSurfaces() {
@@ -172,19 +336,6 @@ void Menu::updateSectionTextSurfaces() {
 		section_text_surfaces[i] = font.render(sections[i]);
 }
 
-void Menu::calcSectionRange(int &leftSection, int &rightSection) {
-	ConfIntHash &skinConfInt = gmenu2x.skinConfInt;
-	const int linkWidth = skinConfInt["linkWidth"];
-	const int screenWidth = gmenu2x.width();
-	const int numSections = sections.size();
-	rightSection = min(
-			max(1, (screenWidth - 20 - linkWidth) / (2 * linkWidth)),
-			numSections / 2);
-	leftSection = max(
-			-rightSection,
-			rightSection - numSections + 1);
-}
-
 bool Menu::runAnimations() {
 	if (sectionAnimation.isRunning()) {
 		sectionAnimation.step();
@@ -195,18 +346,15 @@ bool Menu::runAnimations() {
 void Menu::paint(Surface &s) {
 	const uint32_t width = s.width(), height = s.height();
 	auto &font = *gmenu2x.font;
-	SurfaceCollection &sc = gmenu2x.sc;
 
-	ConfIntHash &skinConfInt = gmenu2x.skinConfInt;
-	const int topBarHeight = skinConfInt["topBarHeight"];
-	const int bottomBarHeight = skinConfInt["bottomBarHeight"];
-	const int linkWidth = skinConfInt["linkWidth"];
-	const int linkHeight = skinConfInt["linkHeight"];
+	const int topBarHeight = grid.topBarHeight;
+	const int bottomBarHeight = grid.bottomBarHeight;
+	const int linkWidth = grid.linkWidth;
+	const int linkHeight = grid.linkHeight;
 	RGBAColor &selectionBgColor = gmenu2x.skinConfColors[COLOR_SELECTION_BG];
 
 	// Apply section header animation.
-	int leftSection, rightSection;
-	calcSectionRange(leftSection, rightSection);
+	int leftSection = grid.leftSection, rightSection = grid.rightSection;
 	int sectionFP = sectionAnimation.currentValue();
 	int sectionDelta = (sectionFP * linkWidth + (1 << 15)) >> 16;
 	int centerSection = iSection - sectionDelta / linkWidth;
@@ -223,10 +371,6 @@ void Menu::paint(Surface &s) {
 	const uint32_t numSections = sections.size();
 	for (int i = leftSection; i <= rightSection; i++) {
 		uint32_t j = (centerSection + numSections + i) % numSections;
-		string sectionIcon = "skin:sections/" + sections[j] + ".png";
-		Surface *icon = sc.exists(sectionIcon)
-				? sc[sectionIcon]
-				: sc.skinRes("icons/section.png");
 		int x = width / 2 + i * linkWidth + sectionDelta;
 		if (i == leftSection) {
 			int t = sectionDelta > 0 ? linkWidth - sectionDelta : -sectionDelta;
@@ -235,7 +379,8 @@ void Menu::paint(Surface &s) {
 			int t = sectionDelta < 0 ? sectionDelta + linkWidth : sectionDelta;
 			x += (((t * t) / linkWidth) * t) / linkWidth;
 		}
-		icon->blit(s, x - 16, sectionLinkPadding, 32, 32);
+		if (auto icon = grid.sectionIcons[j])
+			icon->blit(s, x - 16, sectionLinkPadding, 32, 32);
 		
 		// Center text horizontally and align to bottom.
 		const auto *text_surface = section_text_surfaces[j].get();
@@ -246,39 +391,61 @@ void Menu::paint(Surface &s) {
 		);
 	}
 
-	if (!gmenu2x.skinConfInt["hideLR"]) {
-		auto l_button = sc.skinRes("imgs/section-l.png");
-		if (l_button)
-			l_button->blit(s, 0, 0);
-		auto r_button = sc.skinRes("imgs/section-r.png");
-		if (r_button)
-			r_button->blit(s, width - 10, 0);
+	if (grid.lButton)
+		grid.lButton->blit(s, 0, 0);
+	if (grid.rButton)
+		grid.rButton->blit(s, width - 10, 0);
+
+	//Links: while switching sections, the pages of the two sections slide
+	//along with their headers.
+	const int n = numSections;
+	const int pageSection = (centerSection % n + n) % n;
+	const int pageX = sectionDelta * (int)width / linkWidth;
+	//A fast slide passes sections that are further than the neighbours of
+	//the selected one, so they may not be loaded yet.
+	if (pageSection != iSection)
+		loadSection(pageSection);
+	if (auto page = sectionPage(pageSection))
+		page->blit(s, pageX, grid.pageY);
+	if (sectionDelta != 0) {
+		const int next = sectionDelta > 0 ? -1 : 1;
+		const int nextSection = (pageSection + next + n) % n;
+		loadSection(nextSection);
+		if (auto page = sectionPage(nextSection))
+			page->blit(s, pageX + next * (int)width, grid.pageY);
 	}
 
+	// Draw the selection under the selected link, over the wallpaper.
 	auto& sectionLinks = links[iSection];
 	auto numLinks = sectionLinks.size();
+	const uint32_t first = iFirstDispRow * linkColumns;
+	const uint32_t hover = iLink - first;
+	if (pageSection == iSection && sectionDelta == 0
+			&& hover < grid.x.size() && first + hover < numLinks) {
+		SDL_Rect rect = {
+			grid.x[hover], grid.y[hover],
+			static_cast<Uint16>(linkWidth), static_cast<Uint16>(linkHeight)
+		};
+		s.setClipRect(rect);
+		gmenu2x.bgmain->blit(s, 0, 0);
+		s.clearClipRect();
+		if (grid.selection) {
+			grid.selection->blit(s, rect, Font::HAlignCenter, Font::VAlignMiddle);
+		} else {
+			s.box(rect, selectionBgColor);
+		}
+		paintLink(s, *sectionLinks[first + hover], hover, 0);
+	}
+
 	gmenu2x.drawScrollBar(
 			linkRows, (numLinks + linkColumns - 1) / linkColumns, iFirstDispRow);
 
-	//Links
-	const uint32_t linksPerPage = linkColumns * linkRows;
-	const int linkSpacingX = (width - 10 - linkColumns * linkWidth) / linkColumns;
-	const int linkMarginX = (
-			width - linkWidth * linkColumns - linkSpacingX * (linkColumns - 1)
-			) / 2;
-	const int linkSpacingY = (height - 35 - topBarHeight - linkRows * linkHeight) / linkRows;
-	for (uint32_t i = iFirstDispRow * linkColumns; i < iFirstDispRow * linkColumns + linksPerPage && i < numLinks; i++) {
-		const int ir = i - iFirstDispRow * linkColumns;
-		const int x = linkMarginX + (ir % linkColumns) * (linkWidth + linkSpacingX);
-		const int y = ir / linkColumns * (linkHeight + linkSpacingY) + topBarHeight + 2;
-		sectionLinks.at(i)->setPosition(x, y);
-
-		if (i == (uint32_t)iLink) {
-			sectionLinks.at(i)->paintHover();
-		}
-
-		sectionLinks.at(i)->paint();
-	}
+	// Keep the pages that may be slid in next.
+	pages.erase(remove_if(pages.begin(), pages.end(),
+			[this, n](Page const& p) {
+				int distance = abs(p.section - iSection);
+				return p.section >= n || min(distance, n - distance) > 1;
+			}), pages.end());
 
 	if (selLink())
 		selLink()->paintDescription(width / 2, height - bottomBarHeight + 2);
@@ -291,9 +458,8 @@ void Menu::paint(Surface &s) {
 				Font::HAlignLeft, Font::VAlignMiddle);
 #endif
 		//Manual indicator
-		if (!linkApp->getManual().empty())
-			sc.skinRes("imgs/manual.png")->blit(
-					s, gmenu2x.manualX, gmenu2x.bottomBarIconY);
+		if (!linkApp->getManual().empty() && grid.manual)
+			grid.manual->blit(s, gmenu2x.manualX, gmenu2x.bottomBarIconY);
 	}
 }
 
@@ -342,6 +508,7 @@ vector<unique_ptr<Link>> *Menu::sectionLinks(int i)
 		return nullptr;
 	}
 
+	loadSection(i);
 	return &links[i];
 }
 
@@ -372,6 +539,14 @@ void Menu::setSectionIndex(int i) {
 
 	iLink = 0;
 	iFirstDispRow = 0;
+
+	// Load the neighbours too, as switching to them slides them in.
+	const int numSections = sections.size();
+	if (numSections == 0)
+		return;
+	loadSection(i);
+	loadSection((i + 1) % numSections);
+	loadSection((i + numSections - 1) % numSections);
 }
 
 /*====================================
@@ -383,7 +558,6 @@ void Menu::addActionLink(uint32_t section, string const& title, Action action,
 	assert(section < sections.size());
 
 	Link *link = new Link(gmenu2x, action);
-	link->setSize(gmenu2x.skinConfInt["linkWidth"], gmenu2x.skinConfInt["linkHeight"]);
 	link->setTitle(title);
 	link->setDescription(description);
 	if (gmenu2x.sc.exists(icon)
@@ -393,7 +567,7 @@ void Menu::addActionLink(uint32_t section, string const& title, Action action,
 		link->setIcon(icon);
 	}
 
-	links[section].emplace_back(link);
+	insertLink(section, link);
 }
 
 bool Menu::addLink(string const& path, string const& file)
@@ -436,11 +610,9 @@ bool Menu::addLink(string const& path, string const& file)
 		fl.browse(dirPath);
 		bool found = false;
 		for (size_t x=0; x<fl.size() && !found; x++) {
-			string lcfilename = fl[x];
-
-			if (lcfilename.find("readme") != string::npos) {
+			if (fl[x].find("readme") != compat::string_view::npos) {
 				found = true;
-				manual = dirPath + fl.getFiles()[x];
+				manual = dirPath + string(fl[x]);
 			}
 		}
 	}
@@ -469,8 +641,7 @@ bool Menu::addLink(string const& path, string const& file)
 
 		auto idx = sectionNamed(sectionName);
 		auto link = new LinkApp(gmenu2x, linkpath, true);
-		link->setSize(gmenu2x.skinConfInt["linkWidth"], gmenu2x.skinConfInt["linkHeight"]);
-		links[idx].emplace_back(link);
+		insertLink(idx, link);
 	} else {
 
 		ERROR("Error while opening the file '%s' for write.\n", linkpath.c_str());
@@ -481,6 +652,32 @@ bool Menu::addLink(string const& path, string const& file)
 	return true;
 }
 
+void Menu::importLinks(vector<pair<string, string>> const& sectionFiles)
+{
+	vector<string> names;
+	for (auto const& entry : sectionFiles)
+		names.push_back(entry.first);
+	addSections(names);
+
+	set<int> unsorted;
+	for (auto const& entry : sectionFiles) {
+		// Sections that are not loaded yet will read the new files then.
+		if (!loadedSections.count(entry.first))
+			continue;
+
+		auto idx = sectionNamed(entry.first);
+		auto link = new LinkApp(gmenu2x, entry.second, true);
+		if (!link->targetExists()) {
+			delete link;
+			continue;
+		}
+		links[idx].emplace_back(link);
+		unsorted.insert(idx);
+	}
+	for (auto idx : unsorted)
+		orderLinks(idx);
+}
+
 int Menu::sectionNamed(const char *sectionName)
 {
 	auto it = lower_bound(sections.begin(), sections.end(), sectionName);
@@ -488,12 +685,13 @@ int Menu::sectionNamed(const char *sectionName)
 	if (it == sections.end() || *it != sectionName) {
 		sections.emplace(it, sectionName);
 		links.emplace(links.begin() + idx);
+		section_text_surfaces.emplace(section_text_surfaces.begin() + idx,
+				gmenu2x.font->render(sectionName));
 		// Make sure the selected section doesn't change.
 		if (idx <= iSection) {
 			iSection++;
 		}
-
-		updateSectionTextSurfaces();
+		updateSectionHeaders();
 	}
 	return idx;
 }
@@ -504,8 +702,16 @@ void Menu::deleteSelectedLink()
 
 	INFO("Deleting link '%s'\n", selLink()->getTitle().c_str());
 
-	if (selLinkApp()!=NULL)
+	if (selLinkApp()!=NULL) {
 		unlink(selLinkApp()->getFile().c_str());
+#ifdef HAVE_LIBOPK
+		if (selLinkApp()->isOpk()) {
+			auto it = findPackageLink(selLinkApp());
+			if (it != packageLinks.end())
+				packageLinks.erase(it);
+		}
+#endif
+	}
 	sectionLinks()->erase( sectionLinks()->begin() + selLinkIndex() );
 	setLinkIndex(selLinkIndex());
 
@@ -519,18 +725,32 @@ void Menu::deleteSelectedLink()
 	}
 	if (!icon_used) {
 		gmenu2x.sc.del(iconpath);
+		// It may have been a section icon.
+		updateSectionHeaders();
 	}
 }
 
 void Menu::deleteSelectedSection()
 {
-	string const& sectionName = selSection();
+	string const sectionName = selSection();
 	INFO("Deleting section '%s'\n", sectionName.c_str());
 
 	gmenu2x.sc.del("sections/" + sectionName + ".png");
+#ifdef HAVE_LIBOPK
+	for (auto it = packageLinks.begin(); it != packageLinks.end(); ) {
+		if (it->second.section == sectionName) {
+			it = packageLinks.erase(it);
+		} else {
+			++it;
+		}
+	}
+#endif
+	loadedSections.erase(sectionName);
 	auto idx = selSectionIndex();
 	links.erase(links.begin() + idx);
 	sections.erase(sections.begin() + idx);
+	section_text_surfaces.erase(section_text_surfaces.begin() + idx);
+	updateSectionHeaders();
 	setSectionIndex(0); //reload sections
 
 	string path = GMenu2X::getHome() + "/sections/" + sectionName;
@@ -552,6 +772,9 @@ bool Menu::moveSelectedLink(string const& newSection)
 	// Note: Get new index first, since it might move the selected index.
 	auto const newSectionIndex = sectionNamed(newSection);
 	auto const oldSectionIndex = iSection;
+	// Load the new section before the file is moved there, or the link
+	// would be loaded twice.
+	loadSection(newSectionIndex);
 
 	string const& file = linkApp->getFile();
 	string linkTitle = file.substr(file.rfind('/') + 1);
@@ -570,19 +793,25 @@ bool Menu::moveSelectedLink(string const& newSection)
 	}
 	linkApp->setFile(newFileName);
 
-	// Fetch sections.
-	auto& newSectionLinks = links[newSectionIndex];
+#ifdef HAVE_LIBOPK
+	if (linkApp->isOpk()) {
+		auto it = findPackageLink(linkApp);
+		if (it != packageLinks.end())
+			it->second.section = newSection;
+	}
+#endif
+
+	// Fetch section.
 	auto& oldSectionLinks = links[oldSectionIndex];
 
 	// Move link.
 	auto it = oldSectionLinks.begin() + iLink;
 	auto link = it->release();
 	oldSectionLinks.erase(it);
-	newSectionLinks.emplace_back(link);
 
 	// Select the same link in the new section.
 	setSectionIndex(newSectionIndex);
-	setLinkIndex(newSectionLinks.size() - 1);
+	setLinkIndex(insertLink(newSectionIndex, link));
 
 	return true;
 }
@@ -645,7 +874,7 @@ Link *Menu::selLink() {
 }
 
 LinkApp *Menu::selLinkApp() {
-	return dynamic_cast<LinkApp*>(selLink());
+	return LinkApp::from(selLink());
 }
 
 void Menu::setLinkIndex(int i) {
@@ -674,83 +903,145 @@ void Menu::setLinkIndex(int i) {
 void Menu::openPackagesFromDir(std::string const& path)
 {
 	DEBUG("Opening packages from directory: %s\n", path.c_str());
-	if (readPackages(path)) {
+	vector<string> paths;
+	if (findPackages(path, paths)) {
+		openPackages(paths);
 #ifdef ENABLE_INOTIFY
 		monitors.emplace_back(new Monitor(path.c_str(), this));
 #endif
 	}
 }
 
-void Menu::openPackage(std::string const& path, bool order)
+/* Moves to the next meta-data of the package that is meant for one of
+ * the given platforms. */
+static bool nextPackageMetadata(struct OPK *opk,
+			vector<string> const& platforms, const char **name)
 {
-#ifdef ENABLE_INOTIFY
-	/* First try to remove existing links of the same OPK
-	 * (needed for instance when an OPK is modified) */
-	removePackageLink(path);
-#endif
+	for (;;) {
+		string::size_type pos;
+		int ret = opk_open_metadata(opk, name);
+		if (ret < 0) {
+			ERROR("Error while loading meta-data\n");
+			return false;
+		} else if (!ret)
+		  return false;
 
-	struct OPK *opk = opk_open(path.c_str());
-	if (!opk) {
-		ERROR("Unable to open OPK %s\n", path.c_str());
-		return;
-	}
+		/* Strip .desktop */
+		string metadata(*name);
+		pos = metadata.rfind('.');
+		metadata = metadata.substr(0, pos);
 
-	for (;;) {
-		bool has_metadata = false;
-		const char *name;
+		/* Keep only the platform name */
+		pos = metadata.rfind('.');
+		metadata = metadata.substr(pos + 1);
 
-		std::vector<std::string> platforms;
+		if (std::find(platforms.begin(), platforms.end(),
+			      metadata) != platforms.end()) {
+			return true;
+		}
+	}
+}
 
-		split(platforms, gmenu2x.confStr["opkPlatforms"], ",");
-		platforms.push_back("all");
+void Menu::openPackages(vector<string> const& paths)
+{
+	if (paths.empty())
+		return;
 
-		for (;;) {
-			string::size_type pos;
-			int ret = opk_open_metadata(opk, &name);
-			if (ret < 0) {
-				ERROR("Error while loading meta-data\n");
-				break;
-			} else if (!ret)
-			  break;
+#ifdef ENABLE_INOTIFY
+	/* First try to remove existing links of the same OPKs
+	 * (needed for instance when an OPK is modified) */
+	for (auto const& path : paths)
+		removePackageLink(path);
+#endif
 
-			/* Strip .desktop */
-			string metadata(name);
-			pos = metadata.rfind('.');
-			metadata = metadata.substr(0, pos);
+	std::vector<std::string> platforms;
+
+	split(platforms, gmenu2x.confStr["opkPlatforms"], ",");
+	platforms.push_back("all");
+
+	/* Opening a package is mostly waiting for the storage, so several are
+	 * opened at once. The links are created on this thread only. */
+	vector<struct OPK *> opks(paths.size());
+	vector<const char *> names(paths.size());
+	std::atomic<size_t> next(0);
+	auto open = [&]() {
+		for (size_t i; (i = next++) < paths.size(); ) {
+			opks[i] = opk_open(paths[i].c_str());
+			if (opks[i] && !nextPackageMetadata(opks[i], platforms, &names[i]))
+				names[i] = nullptr;
+		}
+	};
+	size_t numThreads = min<size_t>(
+			min(std::thread::hardware_concurrency(), 4u), paths.size());
+	vector<std::thread> threads;
+	for (size_t i = 1; i < numThreads; i++)
+		threads.emplace_back(open);
+	open();
+	for (auto& thread : threads)
+		thread.join();
+
+	/* A single package is inserted where it belongs; the links of many
+	 * are appended and their sections sorted once at the end. */
+	const bool bulk = paths.size() > 1;
+	vector<LinkApp *> created;
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (!opks[i]) {
+			ERROR("Unable to open OPK %s\n", paths[i].c_str());
+			continue;
+		}
 
-			/* Keep only the platform name */
-			pos = metadata.rfind('.');
-			metadata = metadata.substr(pos + 1);
+		for (const char *name = names[i]; name; ) {
+			auto key = make_pair(paths[i], string(name));
+			if (packageLinks.count(key)) {
+				DEBUG("Skipping duplicate meta-data %s of package %s\n",
+						name, paths[i].c_str());
+			} else {
+				// Note: OPK links can only be deleted by removing the OPK itself,
+				//       but that is not something we want to do in the menu,
+				//       so consider this link undeletable.
+				auto link = new LinkApp(gmenu2x, paths[i], false, opks[i], name);
+
+				if (bulk) {
+					created.push_back(link);
+				} else {
+					insertLink(sectionNamed(link->getCategory()), link);
+				}
+				packageLinks[key] = PackageLink { link->getCategory(), link };
 
-			if (std::find(platforms.begin(), platforms.end(),
-				      metadata) != platforms.end()) {
-				has_metadata = true;
-				break;
+				createSectionDir(link->getCategory());
 			}
+
+			if (!nextPackageMetadata(opks[i], platforms, &name))
+				break;
 		}
 
-		if (!has_metadata)
-		  break;
+		opk_close(opks[i]);
+	}
+
+	/* Creating the links cached their icons; drop those of older versions
+	 * of the packages. */
+	OpkIconCache::instance().RemoveStale(paths);
 
-		// Note: OPK links can only be deleted by removing the OPK itself,
-		//       but that is not something we want to do in the menu,
-		//       so consider this link undeletable.
-		auto link = new LinkApp(gmenu2x, path, false, opk, name);
-		link->setSize(gmenu2x.skinConfInt["linkWidth"], gmenu2x.skinConfInt["linkHeight"]);
+	if (created.empty())
+		return;
+
+	vector<string> categories;
+	for (auto link : created)
+		categories.push_back(link->getCategory());
+	addSections(categories);
 
+	set<int> unsorted;
+	for (auto link : created) {
 		auto idx = sectionNamed(link->getCategory());
 		links[idx].emplace_back(link);
-
-		createSectionDir(link->getCategory());
+		unsorted.insert(idx);
 	}
-
-	opk_close(opk);
-
-	if (order)
-		orderLinks();
+	for (auto idx : unsorted)
+		orderLinks(idx);
 }
 
-bool Menu::readPackages(std::string const& parentDir)
+bool Menu::findPackages(std::string const& parentDir, vector<string>& paths)
 {
 	DIR *dirp = opendir(parentDir.c_str());
 	if (!dirp) {
@@ -774,95 +1065,283 @@ bool Menu::readPackages(std::string const& parentDir)
 			continue;
 		}
 
-		openPackage(parentDir + '/' + dptr->d_name, false);
+		paths.push_back(parentDir + '/' + dptr->d_name);
 	}
 
 	closedir(dirp);
-	orderLinks();
 
 	return true;
 }
 
+Menu::PackageLinkMap::iterator Menu::findPackageLink(LinkApp *link)
+{
+	auto it = packageLinks.lower_bound(make_pair(link->getOpkFile(), string()));
+	for (; it != packageLinks.end() && it->first.first == link->getOpkFile(); ++it) {
+		if (it->second.link == link)
+			return it;
+	}
+	return packageLinks.end();
+}
+
 #ifdef ENABLE_INOTIFY
+void Menu::queuePackageEvent(PackageEvent event, std::string const& path)
+{
+	packageEvents.Push(make_pair(event, path));
+}
+
+bool Menu::applyPackageEvents()
+{
+	auto events = packageEvents.TakeAll();
+	if (events.empty())
+		return false;
+
+	/* Only the last event of a path counts, and removing a directory
+	 * cancels the earlier events of the packages in it. */
+	vector<pair<PackageEvent, string>> batch;
+	for (auto& event : events) {
+		const string& path = event.second;
+		const bool removed = event.first == PackageEvent::REMOVED;
+		batch.erase(remove_if(batch.begin(), batch.end(),
+				[&](pair<PackageEvent, string> const& queued) {
+					return queued.second.compare(0, path.size(), path) == 0
+						&& (removed || queued.second.size() == path.size());
+				}), batch.end());
+		batch.push_back(std::move(event));
+	}
+	DEBUG("Applying %zu package events in a batch of %zu\n",
+			events.size(), batch.size());
+
+	/* Packages are only opened after all removals: an addition that
+	 * came before the removal of its directory was dropped above, and
+	 * one that came after it must not be undone. */
+	vector<string> added;
+	for (auto& event : batch) {
+		switch (event.first) {
+			case PackageEvent::REMOVED:
+				removePackageLink(event.second);
+				/* The icons of packages on removed media are kept,
+				 * in case the media comes back. */
+				if (event.second.size() > 4 && !strcasecmp(
+						event.second.c_str() + event.second.size() - 4, ".opk"))
+					OpkIconCache::instance().Remove(event.second);
+				break;
+			case PackageEvent::ADDED:
+				added.push_back(std::move(event.second));
+				break;
+			case PackageEvent::DIRECTORY_ADDED:
+				DEBUG("Opening packages from directory: %s\n",
+						event.second.c_str());
+				if (findPackages(event.second, added)) {
+					monitors.emplace_back(
+							new Monitor(event.second.c_str(), this));
+				}
+				break;
+		}
+	}
+	openPackages(added);
+
+	return true;
+}
+
 /* Remove all links that correspond to the given path.
  * If "path" is a directory, it will remove all links that
  * correspond to an OPK present in the directory. */
 void Menu::removePackageLink(std::string const& path)
 {
-	for (auto section = links.begin(); section != links.end(); ++section) {
-		for (auto link = section->begin(); link != section->end(); ++link) {
-			LinkApp *app = dynamic_cast<LinkApp *>(link->get());
-			if (!app || !app->isOpk() || app->getOpkFile().empty())
-				continue;
-
-			if (app->getOpkFile().compare(0, path.size(), path) == 0) {
-				DEBUG("Removing link corresponding to package %s\n",
-							app->getOpkFile().c_str());
-				section->erase(link);
-				if (section - links.begin() == iSection
-							&& iLink == (int) section->size()) {
+	/* The packages under the path follow each other in the registry */
+	auto it = packageLinks.lower_bound(make_pair(path, string()));
+	while (it != packageLinks.end()
+				&& it->first.first.compare(0, path.size(), path) == 0) {
+		DEBUG("Removing link corresponding to package %s\n",
+					it->first.first.c_str());
+		PackageLink const& packageLink = it->second;
+		auto section = lower_bound(sections.begin(), sections.end(),
+					packageLink.section);
+		if (section != sections.end() && *section == packageLink.section) {
+			int idx = section - sections.begin();
+			auto& sectionLinks = links[idx];
+			auto link = find_if(sectionLinks.begin(), sectionLinks.end(),
+						[&](unique_ptr<Link> const& link) {
+							return link.get() == packageLink.link;
+						});
+			if (link != sectionLinks.end()) {
+				sectionLinks.erase(link);
+				if (idx == iSection && iLink == (int) sectionLinks.size()) {
 					setLinkIndex(iLink - 1);
 				}
-				--link;
 			}
 		}
+		it = packageLinks.erase(it);
 	}
 
 	/* Remove registered monitors */
-	for (auto it = monitors.begin(); it < monitors.end(); ++it) {
+	for (auto it = monitors.begin(); it < monitors.end(); ) {
 		if ((*it)->getPath().compare(0, path.size(), path) == 0) {
-			monitors.erase(it);
+			it = monitors.erase(it);
+		} else {
+			++it;
 		}
 	}
 }
 #endif
 #endif
 
+static bool link_less(Link const& a, Link const& b)
+{
+	int cmp = a.getSortKey().compare(b.getSortKey());
+	return cmp != 0 ? cmp < 0 : a.getTitle() < b.getTitle();
+}
+
 static bool compare_links(unique_ptr<Link> const& a, unique_ptr<Link> const& b)
 {
-	LinkApp *app1 = dynamic_cast<LinkApp *>(a.get());
-	LinkApp *app2 = dynamic_cast<LinkApp *>(b.get());
-	bool app1_is_opk = app1 && app1->isOpk(),
-		 app2_is_opk = app2 && app2->isOpk();
+	return link_less(*a, *b);
+}
 
-	if (app1_is_opk && !app2_is_opk) {
-		return false;
+void Menu::orderLinks()
+{
+	for (size_t i = 0; i < links.size(); i++) {
+		orderLinks(i);
 	}
-	if (app2_is_opk && !app1_is_opk) {
-		return true;
+}
+
+void Menu::orderLinks(int section)
+{
+	auto& sectionLinks = links[section];
+	Link *selected = nullptr;
+	if (section == iSection && iLink >= 0
+				&& iLink < (int) sectionLinks.size()) {
+		selected = sectionLinks[iLink].get();
+	}
+
+	ParallelSort(sectionLinks.begin(), sectionLinks.end(), compare_links);
+
+	if (selected) {
+		for (size_t i = 0; i < sectionLinks.size(); i++) {
+			if (sectionLinks[i].get() == selected) {
+				setLinkIndex(i);
+				break;
+			}
+		}
 	}
-	return a->getTitle().compare(b->getTitle()) < 0;
 }
 
-void Menu::orderLinks()
+int Menu::insertLink(int section, Link *link)
 {
-	for (auto& section : links) {
-		sort(section.begin(), section.end(), compare_links);
+	auto& sectionLinks = links[section];
+	auto it = upper_bound(sectionLinks.begin(), sectionLinks.end(), link,
+			[](Link *link, unique_ptr<Link> const& other) {
+				return link_less(*link, *other);
+			});
+	int idx = it - sectionLinks.begin();
+	sectionLinks.emplace(it, link);
+
+	// Keep the same link selected.
+	if (section == iSection) {
+		if (iLink >= 0 && idx <= iLink) {
+			iLink++;
+		}
+		setLinkIndex(max(iLink, 0));
 	}
+	return idx;
 }
 
-void Menu::readLinks()
+void Menu::loadSection(int section)
 {
-	iLink = 0;
-	iFirstDispRow = 0;
+	if (section < 0 || section >= (int)sections.size()
+			|| !loadedSections.insert(sections[section]).second)
+		return;
 
-	for (size_t i=0; i<links.size(); i++) {
-		links[i].clear();
+	string const& name = sections[section];
+	vector<unique_ptr<LinkApp>> loaded;
+	readLinksOfSection(
+			loaded, GMENU2X_SYSTEM_DIR "/sections/" + name, false);
+	readLinksOfSection(
+			loaded, GMenu2X::getHome() + "/sections/" + name, true);
+	if (loaded.empty())
+		return;
 
-		int correct = (i>sections.size() ? iSection : i);
-		string const& section = sections[correct];
+	TargetChecker::Batch batch { name, {} };
+	for (auto& link : loaded) {
+		batch.targets.push_back({ link->getFile(), link->getTarget() });
+		links[section].emplace_back(link.release());
+	}
+	orderLinks(section);
+	targetChecker.Check(std::move(batch));
+}
+
+bool Menu::applyTargetChecks()
+{
+	auto batches = targetChecker.TakeMissing();
+	for (auto& batch : batches) {
+		auto it = lower_bound(sections.begin(), sections.end(), batch.section);
+		if (it == sections.end() || *it != batch.section)
+			continue;
+		const int section = it - sections.begin();
+
+		set<string> missing;
+		for (auto& target : batch.targets) {
+			DEBUG("Removing link '%s': '%s' does not exist\n",
+					target.file.c_str(), target.path.c_str());
+			missing.insert(std::move(target.file));
+		}
 
-		readLinksOfSection(
-				links[i], GMENU2X_SYSTEM_DIR "/sections/" + section, false);
-		readLinksOfSection(
-				links[i], GMenu2X::getHome() + "/sections/" + section, true);
+		auto& sectionLinks = links[section];
+		for (size_t i = 0; i < sectionLinks.size(); ) {
+			LinkApp *app = LinkApp::from(sectionLinks[i].get());
+			if (!app || !missing.count(app->getFile())) {
+				i++;
+				continue;
+			}
+			sectionLinks.erase(sectionLinks.begin() + i);
+			// Keep the same link selected.
+			if (section == iSection && (int)i < iLink)
+				iLink--;
+		}
+		if (section == iSection)
+			setLinkIndex(min(iLink, (int)sectionLinks.size() - 1));
 	}
+	return !batches.empty();
+}
+
+vector<string> Menu::getSelectorDirs()
+{
+	vector<string> dirs;
+	for (size_t i = 0; i < sections.size(); i++) {
+		for (auto& link : links[i]) {
+			LinkApp *app = LinkApp::from(link.get());
+			if (app && !app->getSelectorDir().empty())
+				dirs.push_back(app->getSelectorDir());
+		}
+		if (loadedSections.count(sections[i]))
+			continue;
 
-	orderLinks();
+		for (auto dir : { string(GMENU2X_SYSTEM_DIR "/sections/"),
+				GMenu2X::getHome() + "/sections/" }) {
+			dir += sections[i];
+			DIR *dirp = opendir(dir.c_str());
+			if (!dirp) continue;
+			while (struct dirent *dptr = readdir(dirp)) {
+				if (dptr->d_type != DT_REG) continue;
+				ifstream infile(dir + '/' + dptr->d_name);
+				string line;
+				while (getline(infile, line)) {
+					string::size_type pos = line.find('=');
+					if (pos != string::npos
+							&& trim(line.substr(0, pos)) == "selectordir") {
+						string value = trim(line.substr(pos + 1));
+						if (!value.empty()) dirs.push_back(value);
+						break;
+					}
+				}
+			}
+			closedir(dirp);
+		}
+	}
+	return dirs;
 }
 
 void Menu::readLinksOfSection(
-		vector<unique_ptr<Link>>& links, string const& path, bool deletable)
+		vector<unique_ptr<LinkApp>>& links, string const& path, bool deletable)
 {
 	DIR *dirp = opendir(path.c_str());
 	if (!dirp) return;
@@ -871,15 +1350,7 @@ void Menu::readLinksOfSection(
 		if (dptr->d_type != DT_REG) continue;
 		string linkfile = path + '/' + dptr->d_name;
 
-		LinkApp *link = new LinkApp(gmenu2x, linkfile, deletable);
-		if (link->targetExists()) {
-			link->setSize(
-					gmenu2x.skinConfInt["linkWidth"],
-					gmenu2x.skinConfInt["linkHeight"]);
-			links.emplace_back(link);
-		} else {
-			delete link;
-		}
+		links.emplace_back(new LinkApp(gmenu2x, linkfile, deletable));
 	}
 
 	closedir(dirp);
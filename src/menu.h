@@ -24,10 +24,15 @@
 #include "iconbutton.h"
 #include "layer.h"
 #include "link.h"
+#include "mpsc_queue.h"
+#include "target_checker.h"
 
 #include <functional>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 class GMenu2X;
@@ -64,30 +69,100 @@ private:
 
 	uint32_t linkColumns, linkRows;
 
-	Animation sectionAnimation;
+	/**
+	 * The layout of a page of links, which only depends on the skin and the
+	 * font. Cell i shows link i of the first displayed row, and its
+	 * positions are at index i of each array.
+	 * Also holds what paint() needs of the skin and of the section headers,
+	 * so that painting does not look anything up by name.
+	 */
+	struct Grid {
+		int linkWidth, linkHeight, topBarHeight, bottomBarHeight;
+		// The area that pages of links are drawn in.
+		int pageY, pageHeight;
+		std::vector<Sint16> x, y;
+		std::vector<Sint16> iconX, iconY;
+		// The bottom center of the title.
+		std::vector<Sint16> titleX, titleY;
+
+		// NULL if not drawn.
+		OffscreenSurface *lButton = nullptr, *rButton = nullptr;
+		OffscreenSurface *selection = nullptr, *manual = nullptr;
+		// The section headers that are visible, relative to the selected
+		// section at 0, and the icon of each section.
+		int leftSection = 0, rightSection = 0;
+		std::vector<OffscreenSurface *> sectionIcons;
+	} grid;
+	void updateGrid();
+	/**
+	 * Looks up the icons of the sections and the range of the visible
+	 * headers. Called when the skin or the list of sections changes.
+	 */
+	void updateSectionHeaders();
 
 	/**
-	 * Determine which section headers are visible.
-	 * The output values are relative to the middle section at 0.
+	 * A page of links of a section drawn on the wallpaper, so that it can
+	 * be painted, or slid in when switching sections, with a single blit.
 	 */
-	void calcSectionRange(int &leftSection, int &rightSection);
+	struct Page {
+		int section;
+		uint32_t firstRow;
+		// The links drawn in the cells, with their revisions at the time.
+		std::vector<std::pair<const Link *, unsigned int>> cells;
+		std::unique_ptr<OffscreenSurface> surface;
+	};
+	// Only pages of the selected section and its neighbours are kept.
+	std::vector<Page> pages;
+	/**
+	 * Returns the page of the given section, drawing it again if any of
+	 * its links changed since it was drawn.
+	 * @return The page, or NULL if it could not be created.
+	 */
+	OffscreenSurface *sectionPage(int section);
+	void paintLink(Surface& s, Link const& link, uint32_t cell, int offsetY);
 
-	void readLinks();
-	void freeLinks();
+	Animation sectionAnimation;
+
+	/**
+	 * Loads the link files of a section, the first time it is called for
+	 * that section. Sections are loaded when they, or a section next to
+	 * them, are selected, so that starting up does not read them all.
+	 * The links are added at once; those whose target turns out to be
+	 * missing are removed by applyTargetChecks().
+	 */
+	void loadSection(int section);
+	// The names of the sections whose link files are loaded.
+	std::set<std::string> loadedSections;
+	TargetChecker targetChecker;
 
 	// Load all the sections of the given "sections" directory.
 	void readSections(std::string const& parentDir);
+	// Add the given sections that don't exist yet, all in one go.
+	void addSections(std::vector<std::string> names);
 
 #ifdef HAVE_LIBOPK
-	// Load all the .opk packages of the given directory
-	bool readPackages(std::string const& parentDir);
+	// Append the paths of the .opk packages of the given directory
+	bool findPackages(std::string const& parentDir,
+			std::vector<std::string>& paths);
+	// Load the given packages, then sort the links once
+	void openPackages(std::vector<std::string> const& paths);
+
+	struct PackageLink {
+		std::string section;
+		LinkApp *link;
+	};
+	typedef std::map<std::pair<std::string, std::string>, PackageLink>
+		PackageLinkMap;
+	// The links of the loaded packages, by package path and meta-data name.
+	PackageLinkMap packageLinks;
+	PackageLinkMap::iterator findPackageLink(LinkApp *link);
 #ifdef ENABLE_INOTIFY
 	std::vector<std::unique_ptr<Monitor>> monitors;
 #endif
 #endif
 
 	// Load all the links on the given section directory.
-	void readLinksOfSection(std::vector<std::unique_ptr<Link>>& links,
+	void readLinksOfSection(std::vector<std::unique_ptr<LinkApp>>& links,
 							std::string const& path, bool deletable);
 
 	/**
@@ -105,6 +180,15 @@ private:
 	void linkDown();
 
 	void updateSectionTextSurfaces();
+
+	/**
+	 * Inserts a link at its place in the sorted links of a section,
+	 * keeping the same link selected.
+	 * @return The index of the inserted link.
+	 */
+	int insertLink(int section, Link *link);
+	// Sort the links of one section, keeping the same link selected.
+	void orderLinks(int section);
 public:
 	typedef std::function<void(void)> Action;
 
@@ -112,13 +196,35 @@ public:
 	virtual ~Menu();
 
 #ifdef HAVE_LIBOPK
-	void openPackage(std::string const& path, bool order = true);
 	void openPackagesFromDir(std::string const& path);
 #ifdef ENABLE_INOTIFY
 	void removePackageLink(std::string const& path);
+
+	enum class PackageEvent { ADDED, DIRECTORY_ADDED, REMOVED };
+
+	/**
+	 * Queues a change of a package, or of a directory of packages, on disk.
+	 * May be called from any thread; the menu is only changed by the next
+	 * call of applyPackageEvents().
+	 */
+	void queuePackageEvent(PackageEvent event, std::string const& path);
+
+	/**
+	 * Applies the queued package changes in one batch.
+	 * Must be called from the main thread.
+	 * @return Whether there were any.
+	 */
+	bool applyPackageEvents();
 #endif
 #endif
 
+	/**
+	 * Removes the links whose targets were found missing since the last
+	 * call. Must be called from the main thread.
+	 * @return Whether any were.
+	 */
+	bool applyTargetChecks();
+
 	int selSectionIndex();
 	const std::string &selSection();
 	void setSectionIndex(int i);
@@ -127,6 +233,13 @@ public:
 			Action action, std::string const& description="",
 			std::string const& icon="");
 	bool addLink(std::string const& path, std::string const& file);
+	/**
+	 * Adds links from files that were written already, sorting each
+	 * section once instead of once per link.
+	 * @param sectionFiles Pairs of section name and link file.
+	 */
+	void importLinks(
+			std::vector<std::pair<std::string, std::string>> const& sectionFiles);
 
 	/**
 	 * Looks up a section by name, adding it if it doesn't exist yet.
@@ -150,6 +263,8 @@ public:
 
 	// Called when the font has changed but not when it is loaded for the first time.
 	void fontChanged();
+	// Called when the background that the links are drawn on has changed.
+	void backgroundChanged() { pages.clear(); }
 	
 	void orderLinks();
 
@@ -164,7 +279,22 @@ public:
 	void setLinkIndex(int i);
 
 	const std::vector<std::string> &getSections() { return sections; }
+	/**
+	 * Returns the links of a section, loading them if needed.
+	 * @param i The section index, or -1 for the selected section.
+	 */
 	std::vector<std::unique_ptr<Link>> *sectionLinks(int i = -1);
+
+	/**
+	 * The selector directories of the links of all sections. Sections that
+	 * are not loaded yet are read for it without loading them.
+	 */
+	std::vector<std::string> getSelectorDirs();
+
+#if defined(HAVE_LIBOPK) && defined(ENABLE_INOTIFY)
+private:
+	MpscQueue<std::pair<PackageEvent, std::string>> packageEvents;
+#endif
 };
 
 #endif // MENU_H
@@ -3,6 +3,7 @@
 
 #include <climits>
 #include <dirent.h>
+#include <poll.h>
 #include <pthread.h>
 #include <SDL.h>
 #include <signal.h>
@@ -14,14 +15,16 @@
 #include "monitor.h"
 #include "utilities.h"
 
+/* After an event, changes are collected until there are none for this
+ * long, so that copying many packages updates the menu once. */
+static const int SETTLE_TIME_MS = 200;
+/* Longest time that changes are held back while events keep coming. */
+static const int MAX_DELAY_MS = 1000;
+
 void Monitor::inject_event(bool is_add, const char *path)
 {
-	if (is_add)
-		menu->openPackage(path);
-	else
-		menu->removePackageLink(path);
-
-	request_repaint();
+	menu->queuePackageEvent(is_add ? Menu::PackageEvent::ADDED
+				: Menu::PackageEvent::REMOVED, path);
 }
 
 bool Monitor::event_accepted(struct inotify_event &event)
@@ -51,26 +54,54 @@ int Monitor::run()
 
 	DEBUG("Starting watching directory %s\n", path.c_str());
 
-	for (;;) {
-		size_t len = sizeof(struct inotify_event) + NAME_MAX + 1;
-		struct inotify_event event;
-		char buf[256];
+	alignas(struct inotify_event) char buf[4096];
+	bool pending = false;
+	unsigned int pendingSince = 0;
 
-		read(fd, &event, len);
-
-		if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
-			inject_event(false, path.c_str());
-			break;
+	for (;;) {
+		if (pending) {
+			struct pollfd pfd = { fd, POLLIN, 0 };
+			int elapsed = SDL_GetTicks() - pendingSince;
+			if (elapsed >= MAX_DELAY_MS
+					|| poll(&pfd, 1, SETTLE_TIME_MS) == 0) {
+				pending = false;
+				request_repaint();
+				continue;
+			}
 		}
 
-		sprintf(buf, "%s/%s", path.c_str(), event.name);
-
-		if (!event_accepted(event))
+		ssize_t len = read(fd, buf, sizeof(buf));
+		if (len < 0 && errno == EINTR)
 			continue;
+		if (len <= 0) {
+			ERROR("Unable to read inotify events of '%s'\n", path.c_str());
+			break;
+		}
 
-		inject_event(event.mask & (IN_MOVED_TO | IN_CLOSE_WRITE | IN_CREATE), buf);
+		for (ssize_t i = 0; i < len; ) {
+			struct inotify_event *event = (struct inotify_event *) (buf + i);
+			i += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+				inject_event(false, path.c_str());
+				request_repaint();
+				close(fd);
+				return 0;
+			}
+
+			if (!event->len || !event_accepted(*event))
+				continue;
+
+			inject_event(event->mask & (IN_MOVED_TO | IN_CLOSE_WRITE | IN_CREATE),
+						(path + '/' + event->name).c_str());
+			if (!pending) {
+				pending = true;
+				pendingSince = SDL_GetTicks();
+			}
+		}
 	}
 
+	close(fd);
 	return 0;
 }
 
@@ -0,0 +1,130 @@
+#include "mount_watcher.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "debug.h"
+
+namespace {
+
+constexpr char kMountInfoPath[] = "/proc/self/mountinfo";
+
+// Returns the mount point field of a mountinfo line, which is the fifth,
+// with the octal escapes of spaces and other special characters undone.
+std::string MountPoint(const std::string &line) {
+	std::string::size_type start = 0;
+	for (int field = 0; field < 4; ++field) {
+		start = line.find(' ', start);
+		if (start == std::string::npos) return std::string();
+		++start;
+	}
+	const std::string::size_type end = line.find(' ', start);
+	std::string mount_point;
+	for (std::string::size_type i = start; i < end && i < line.size(); ++i) {
+		if (line[i] == '\\' && i + 3 < line.size()) {
+			mount_point += static_cast<char>(((line[i + 1] - '0') << 6) |
+			                                 ((line[i + 2] - '0') << 3) |
+			                                 (line[i + 3] - '0'));
+			i += 3;
+		} else {
+			mount_point += line[i];
+		}
+	}
+	return mount_point;
+}
+
+std::string NormalizePath(const std::string &path) {
+	std::string result = path;
+	while (result.size() > 1 && result.back() == '/') result.pop_back();
+	return result;
+}
+
+}  // namespace
+
+MountWatcher::MountWatcher() {
+	fd_ = open(kMountInfoPath, O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0) {
+		ERROR("Unable to open '%s': %s\n", kMountInfoPath, strerror(errno));
+		return;
+	}
+	Update();
+}
+
+MountWatcher::~MountWatcher() {
+	if (fd_ >= 0) close(fd_);
+}
+
+bool MountWatcher::Update() {
+	std::string table;
+	char buf[4096];
+	for (off_t offset = 0;;) {
+		const ssize_t len = pread(fd_, buf, sizeof(buf), offset);
+		if (len < 0 && errno == EINTR) continue;
+		if (len < 0) {
+			ERROR("Unable to read '%s': %s\n", kMountInfoPath, strerror(errno));
+			return false;
+		}
+		if (len == 0) break;
+		table.append(buf, len);
+		offset += len;
+	}
+
+	std::unordered_map<std::string, std::string> entries;
+	for (std::string::size_type start = 0; start < table.size();) {
+		std::string::size_type end = table.find('\n', start);
+		if (end == std::string::npos) end = table.size();
+		std::string line = table.substr(start, end - start);
+		start = end + 1;
+
+		// Unchanged entries keep the mount point they had.
+		std::string mount_point;
+		auto it = entries_.find(line);
+		if (it != entries_.end()) {
+			mount_point = std::move(it->second);
+		} else {
+			mount_point = MountPoint(line);
+			if (!entries_.empty()) {
+				DEBUG("Mounted: %s\n", mount_point.c_str());
+			}
+		}
+		entries.emplace(std::move(line), std::move(mount_point));
+	}
+	entries_ = std::move(entries);
+	return true;
+}
+
+bool MountWatcher::IsMounted(const std::string &mount_point) const {
+	for (const auto &entry : entries_) {
+		if (entry.second == mount_point) return true;
+	}
+	return false;
+}
+
+bool MountWatcher::WaitFor(const std::string &path, int timeout_ms) {
+	if (fd_ < 0) return false;
+	const std::string mount_point = NormalizePath(path);
+	const auto deadline = std::chrono::steady_clock::now() +
+	                      std::chrono::milliseconds(timeout_ms);
+	for (;;) {
+		if (IsMounted(mount_point)) return true;
+
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+		    deadline - std::chrono::steady_clock::now());
+		if (left.count() <= 0) return false;
+
+		// The kernel flags the file with POLLPRI whenever the table changes.
+		struct pollfd pfd = {fd_, POLLPRI, 0};
+		const int ret = poll(&pfd, 1, left.count());
+		if (ret < 0 && errno != EINTR) {
+			ERROR("Unable to wait for mounts: %s\n", strerror(errno));
+			return false;
+		}
+		if (ret > 0 && !Update()) return false;
+	}
+}
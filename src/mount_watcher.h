@@ -0,0 +1,33 @@
+#ifndef _MOUNT_WATCHER_H_
+#define _MOUNT_WATCHER_H_
+
+#include <string>
+#include <unordered_map>
+
+// Waits for file systems to be mounted, using the notifications the kernel
+// sends when /proc/self/mountinfo changes, instead of checking periodically.
+class MountWatcher {
+ public:
+	// Reads the mount points that exist now.
+	MountWatcher();
+	~MountWatcher();
+
+	MountWatcher(const MountWatcher &) = delete;
+	MountWatcher &operator=(const MountWatcher &) = delete;
+
+	// Waits until something is mounted on `path`, for at most `timeout_ms`.
+	// Returns false if nothing was mounted in time.
+	bool WaitFor(const std::string &path, int timeout_ms);
+
+ private:
+	// Reads the mount table again. Only the entries that were not in the
+	// previous table are parsed.
+	bool Update();
+	bool IsMounted(const std::string &mount_point) const;
+
+	int fd_ = -1;
+	// The lines of the mount table and their mount points.
+	std::unordered_map<std::string, std::string> entries_;
+};
+
+#endif  // _MOUNT_WATCHER_H_
@@ -0,0 +1,51 @@
+#ifndef _MPSC_QUEUE_H_
+#define _MPSC_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// A queue that any number of threads push to without taking a lock, and
+// that a single thread empties all at once.
+template <typename T>
+class MpscQueue {
+ public:
+	MpscQueue() = default;
+	MpscQueue(const MpscQueue &) = delete;
+	MpscQueue &operator=(const MpscQueue &) = delete;
+	~MpscQueue() { TakeAll(); }
+
+	void Push(T value) {
+		Node *node = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+		while (!head_.compare_exchange_weak(node->next, node,
+		                                    std::memory_order_release,
+		                                    std::memory_order_relaxed)) {
+		}
+	}
+
+	// Removes all values and returns them in the order they were pushed.
+	std::vector<T> TakeAll() {
+		Node *node = head_.exchange(nullptr, std::memory_order_acquire);
+		std::vector<T> values;
+		while (node) {
+			values.push_back(std::move(node->value));
+			Node *next = node->next;
+			delete node;
+			node = next;
+		}
+		std::reverse(values.begin(), values.end());
+		return values;
+	}
+
+ private:
+	// The values form a stack, newest first.
+	struct Node {
+		T value;
+		Node *next;
+	};
+
+	std::atomic<Node *> head_{nullptr};
+};
+
+#endif  // _MPSC_QUEUE_H_
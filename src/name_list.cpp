@@ -0,0 +1,221 @@
+#include "name_list.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "collation.h"
+#include "parallel_sort.h"
+
+namespace {
+
+std::uint32_t KeyPrefix(compat::string_view key) {
+	std::uint32_t prefix = 0;
+	for (std::size_t i = 0; i < 4; ++i) {
+		prefix <<= 8;
+		if (i < key.size()) prefix |= static_cast<unsigned char>(key[i]);
+	}
+	return prefix;
+}
+
+// Returns the length of the UTF-8 sequence that starts with `c`.
+std::size_t SequenceLength(char c) {
+	const unsigned char b = c;
+	return b < 0xC0 ? 1 : b < 0xE0 ? 2 : b < 0xF0 ? 3 : 4;
+}
+
+// Compares `a` to `b` cut to the length of `a`, ignoring the case of ASCII
+// letters.
+int CompareFoldedHead(compat::string_view a, compat::string_view b) {
+	const std::size_t length = std::min(a.size(), b.size());
+	for (std::size_t i = 0; i < length; ++i) {
+		const unsigned char x = FoldCase(a[i]), y = FoldCase(b[i]);
+		if (x != y) return x < y ? -1 : 1;
+	}
+	return a.size() <= b.size() ? 0 : 1;
+}
+
+}  // namespace
+
+void NameList::Add(compat::string_view name) {
+	const std::size_t dot = name.rfind('.');
+	Entry entry;
+	entry.offset = arena_.size();
+	entry.length = name.size();
+	entry.stem_length = dot == compat::string_view::npos ? name.size() : dot;
+	entry.key_offset = keys_.size();
+	AppendCollationKey(name, &keys_);
+	entry.key_length = keys_.size() - entry.key_offset;
+	entry.key = KeyPrefix(KeyOf(entry));
+	arena_.append(name.data(), name.size());
+	entries_.push_back(entry);
+	by_name_.clear();
+}
+
+void NameList::Append(const NameList &other) {
+	if (empty()) {
+		*this = other;
+		return;
+	}
+	const std::uint32_t base = arena_.size();
+	const std::uint32_t key_base = keys_.size();
+	arena_ += other.arena_;
+	keys_ += other.keys_;
+	entries_.reserve(entries_.size() + other.entries_.size());
+	for (Entry entry : other.entries_) {
+		entry.offset += base;
+		entry.key_offset += key_base;
+		entries_.push_back(entry);
+	}
+	by_name_.clear();
+}
+
+void NameList::Clear() {
+	arena_.clear();
+	keys_.clear();
+	entries_.clear();
+	by_name_.clear();
+}
+
+bool NameList::Less(const Entry &a, const Entry &b) const {
+	if (a.key != b.key) return a.key < b.key;
+	const int cmp = KeyOf(a).compare(KeyOf(b));
+	return cmp != 0 ? cmp < 0 : NameOf(a) < NameOf(b);
+}
+
+bool NameList::Equal(const Entry &a, const Entry &b) const {
+	return a.length == b.length &&
+	       std::memcmp(arena_.data() + a.offset, arena_.data() + b.offset,
+	                   a.length) == 0;
+}
+
+void NameList::Sort() {
+	ParallelSort(entries_.begin(), entries_.end(),
+	             [this](const Entry &a, const Entry &b) { return Less(a, b); });
+	entries_.erase(std::unique(entries_.begin(), entries_.end(),
+	                           [this](const Entry &a, const Entry &b) {
+		                           return Equal(a, b);
+	                           }),
+	               entries_.end());
+	by_name_.clear();
+}
+
+void NameList::Merge(NameList &&other) {
+	if (other.empty()) return;
+	if (empty()) {
+		*this = std::move(other);
+		return;
+	}
+
+	// The names of `other` are added to the arena, but only the records
+	// are merged, so the names that are already in the list stay put.
+	const std::size_t count = entries_.size();
+	Append(other);
+	std::vector<Entry> merged;
+	merged.reserve(entries_.size());
+	auto less = [this](const Entry &a, const Entry &b) { return Less(a, b); };
+	std::merge(entries_.begin(), entries_.begin() + count,
+	           entries_.begin() + count, entries_.end(),
+	           std::back_inserter(merged), less);
+	merged.erase(std::unique(merged.begin(), merged.end(),
+	                         [this](const Entry &a, const Entry &b) {
+		                         return Equal(a, b);
+	                         }),
+	             merged.end());
+	entries_ = std::move(merged);
+	by_name_.clear();
+}
+
+int NameList::Find(compat::string_view name) const {
+	const std::string key = CollationKey(name);
+	const std::uint32_t prefix = KeyPrefix(key);
+	auto it = std::lower_bound(
+	    entries_.begin(), entries_.end(), name,
+	    [this, &key, prefix](const Entry &entry, compat::string_view value) {
+		    if (entry.key != prefix) return entry.key < prefix;
+		    const int cmp = KeyOf(entry).compare(key);
+		    return cmp != 0 ? cmp < 0 : NameOf(entry) < value;
+	    });
+	if (it == entries_.end() || NameOf(*it) != name) return -1;
+	return it - entries_.begin();
+}
+
+const std::vector<std::uint32_t> &NameList::ByName() const {
+	if (by_name_.size() != entries_.size()) {
+		by_name_.resize(entries_.size());
+		for (std::size_t i = 0; i < by_name_.size(); ++i) by_name_[i] = i;
+		std::sort(by_name_.begin(), by_name_.end(),
+		          [this](std::uint32_t a, std::uint32_t b) {
+			          const compat::string_view x = NameOf(entries_[a]);
+			          const compat::string_view y = NameOf(entries_[b]);
+			          const int cmp = CompareFoldedHead(x, y);
+			          if (cmp != 0) return cmp < 0;
+			          return x.size() != y.size() ? x.size() < y.size() : a < b;
+		          });
+	}
+	return by_name_;
+}
+
+std::pair<std::size_t, std::size_t> NameList::PrefixRange(
+    compat::string_view prefix) const {
+	// Cutting every name to the length of the prefix keeps the index sorted.
+	const std::vector<std::uint32_t> &index = ByName();
+	auto first = std::lower_bound(
+	    index.begin(), index.end(), prefix,
+	    [this](std::uint32_t i, compat::string_view value) {
+		    return CompareFoldedHead(value, NameOf(entries_[i])) > 0;
+	    });
+	auto last = std::upper_bound(
+	    first, index.end(), prefix,
+	    [this](compat::string_view value, std::uint32_t i) {
+		    return CompareFoldedHead(value, NameOf(entries_[i])) < 0;
+	    });
+	return std::make_pair(first - index.begin(), last - index.begin());
+}
+
+int NameList::FindPrefix(compat::string_view prefix) const {
+	const auto range = PrefixRange(prefix);
+	return range.first == range.second ? -1 : by_name_[range.first];
+}
+
+void NameList::NextChars(compat::string_view prefix,
+                         std::vector<std::string> *chars) const {
+	const auto range = PrefixRange(prefix);
+	const std::vector<std::uint32_t> &index = by_name_;
+	for (std::size_t i = range.first; i < range.second;) {
+		const compat::string_view name = NameOf(entries_[index[i]]);
+		if (name.size() == prefix.size()) {
+			++i;
+			continue;
+		}
+		const std::size_t length = std::min(
+		    SequenceLength(name[prefix.size()]), name.size() - prefix.size());
+		chars->emplace_back(name.data() + prefix.size(), length);
+		chars->back()[0] = FoldCase(chars->back()[0]);
+
+		// Skip the other names that continue with the same character.
+		const compat::string_view head = name.substr(0, prefix.size() + length);
+		i = std::upper_bound(
+		        index.begin() + i, index.begin() + range.second, head,
+		        [this](compat::string_view value, std::uint32_t j) {
+			        return CompareFoldedHead(value, NameOf(entries_[j])) < 0;
+		        }) -
+		    index.begin();
+	}
+}
+
+void NameList::ShrinkToFit() {
+	arena_.shrink_to_fit();
+	keys_.shrink_to_fit();
+	entries_.shrink_to_fit();
+}
+
+std::vector<std::string> NameList::ToVector() const {
+	std::vector<std::string> names;
+	names.reserve(size());
+	for (std::size_t i = 0; i < size(); ++i) {
+		const compat::string_view name = (*this)[i];
+		names.emplace_back(name.data(), name.size());
+	}
+	return names;
+}
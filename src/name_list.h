@@ -0,0 +1,132 @@
+#ifndef _NAME_LIST_H_
+#define _NAME_LIST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "compat-string_view.h"
+
+// A list of file names packed into a single buffer.
+//
+// Every name costs its own length, the length of its collation key and a
+// 20-byte record, instead of a separately allocated std::string, so even a
+// directory with 100k entries takes only a few MB. The record also holds the
+// length of the name without its extension, so it does not have to be
+// computed again when the list is drawn.
+//
+// Sorted lists are in collation order (see collation.h), and names with the
+// same key in byte order. The keys are computed once, when names are added,
+// so sorting only compares bytes.
+//
+// Since numbers are ordered by value, the names that start with a given
+// prefix need not follow each other. Prefix searches therefore use a second
+// index of the names in case-insensitive byte order, which costs 4 bytes per
+// name and is built by the first search after the list changes. So unlike
+// the other const methods, those searches must not run concurrently.
+class NameList {
+ public:
+	NameList() = default;
+
+	std::size_t size() const { return entries_.size(); }
+	bool empty() const { return entries_.empty(); }
+
+	compat::string_view operator[](std::size_t i) const {
+		const Entry &entry = entries_[i];
+		return compat::string_view(arena_.data() + entry.offset, entry.length);
+	}
+
+	// The name without its extension, if it has one.
+	compat::string_view stem(std::size_t i) const {
+		const Entry &entry = entries_[i];
+		return compat::string_view(arena_.data() + entry.offset,
+		                           entry.stem_length);
+	}
+
+	void Add(compat::string_view name);
+
+	// Adds the names of `other` at the end, without sorting.
+	void Append(const NameList &other);
+
+	void Clear();
+
+	// Sorts the names and drops duplicates.
+	void Sort();
+
+	// Merges a sorted list into this sorted list, dropping duplicates.
+	void Merge(NameList &&other);
+
+	// Keeps only the names for which `keep(name)` returns true.
+	template <typename Pred>
+	void Filter(Pred keep) {
+		NameList kept;
+		kept.arena_.reserve(arena_.size());
+		kept.keys_.reserve(keys_.size());
+		kept.entries_.reserve(entries_.size());
+		for (std::size_t i = 0; i < entries_.size(); ++i) {
+			if (keep((*this)[i])) kept.Add((*this)[i]);
+		}
+		*this = std::move(kept);
+	}
+
+	// Returns the index of `name` in this sorted list, or -1.
+	int Find(compat::string_view name) const;
+
+	// Returns the index of a name in this sorted list that starts with
+	// `prefix`, ignoring the case of ASCII letters, or -1. Of several such
+	// names, returns the first in case-insensitive byte order, which is not
+	// always the first in the list: "Level 10" comes before "Level 2".
+	int FindPrefix(compat::string_view prefix) const;
+
+	// Appends the distinct characters that follow `prefix` in the names of
+	// this sorted list to `chars`, in byte order. A character is a whole UTF-8
+	// sequence, and ASCII letters are in lower case. Names are matched like
+	// in FindPrefix. Takes a binary search per character found, not a pass
+	// over the names.
+	void NextChars(compat::string_view prefix,
+	               std::vector<std::string> *chars) const;
+
+	// Frees the memory that is reserved for names that are not added yet.
+	void ShrinkToFit();
+
+	std::vector<std::string> ToVector() const;
+
+ private:
+	struct Entry {
+		std::uint32_t offset;  // into arena_
+		std::uint16_t length;
+		std::uint16_t stem_length;
+		// The first four bytes of the collation key, big-endian and
+		// zero-padded, so most comparisons don't have to look at the arena.
+		std::uint32_t key;
+		std::uint32_t key_offset;  // into keys_
+		std::uint16_t key_length;
+	};
+
+	compat::string_view KeyOf(const Entry &entry) const {
+		return compat::string_view(keys_.data() + entry.key_offset,
+		                           entry.key_length);
+	}
+	compat::string_view NameOf(const Entry &entry) const {
+		return compat::string_view(arena_.data() + entry.offset, entry.length);
+	}
+
+	bool Less(const Entry &a, const Entry &b) const;
+	bool Equal(const Entry &a, const Entry &b) const;
+	// Returns the prefix index, building it if the list has changed.
+	const std::vector<std::uint32_t> &ByName() const;
+	// Returns the range of the prefix index with the names that start with
+	// `prefix`, ignoring case.
+	std::pair<std::size_t, std::size_t> PrefixRange(
+	    compat::string_view prefix) const;
+
+	std::string arena_;
+	std::string keys_;
+	std::vector<Entry> entries_;
+	// The indices of entries_ by name, ignoring case; empty when stale.
+	mutable std::vector<std::uint32_t> by_name_;
+};
+
+#endif  // _NAME_LIST_H_
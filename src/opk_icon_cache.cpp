@@ -0,0 +1,251 @@
+#include "opk_icon_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <unordered_map>
+
+#include <SDL.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compat-filesystem.h"
+#include "debug.h"
+#include "gmenu2x.h"
+#include "imageio.h"
+#include "utilities.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'G', '2', 'X', 'O'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kFlagAlpha = 1 << 0;
+
+// Sanity limit for the dimensions in an icon file.
+constexpr std::uint32_t kMaxDimension = 2048;
+
+struct Header {
+	char magic[4];  // "G2XO"
+	std::uint32_t version;
+	// Of the package the icon was extracted from.
+	std::uint64_t dev, ino;
+	std::int64_t mtime_sec, mtime_nsec;
+	std::uint64_t size;
+	std::uint32_t width, height;
+	std::uint32_t flags;
+	std::uint32_t name_length;
+	// Followed by the path of the package, '#' and the name of the icon,
+	// then by the ARGB pixels.
+};
+
+std::uint64_t Hash(const std::string &data,
+                   std::uint64_t hash = 14695981039346656037ull) {
+	// FNV-1a; collisions are caught by the name stored in the file.
+	for (unsigned char c : data) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string Hex(std::uint64_t value) {
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx",
+	         static_cast<unsigned long long>(value));
+	return hex;
+}
+
+// The icons of a package share a prefix, so that they can be found without
+// reading them.
+std::string FilePrefix(const std::string &package) {
+	return Hex(Hash(package)) + "-";
+}
+
+std::string FileName(const std::string &package, const std::string &icon,
+                     const struct stat &st, bool alpha) {
+	const std::string key = icon + '\n' + std::to_string(st.st_dev) + ':' +
+	                        std::to_string(st.st_ino) + ':' +
+	                        std::to_string(st.st_mtim.tv_sec) + '.' +
+	                        std::to_string(st.st_mtim.tv_nsec) + ':' +
+	                        std::to_string(st.st_size) + (alpha ? "a" : "");
+	return FilePrefix(package) + Hex(Hash(key));
+}
+
+bool SamePackage(const Header &header, const struct stat &st) {
+	return header.dev == static_cast<std::uint64_t>(st.st_dev) &&
+	       header.ino == static_cast<std::uint64_t>(st.st_ino) &&
+	       header.mtime_sec == st.st_mtim.tv_sec &&
+	       header.mtime_nsec == st.st_mtim.tv_nsec &&
+	       header.size == static_cast<std::uint64_t>(st.st_size);
+}
+
+// Reads the header of a cached icon. Returns false if it is not one.
+bool ReadHeader(const std::string &file, Header *header) {
+	const int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return false;
+	const bool ok = read(fd, header, sizeof(*header)) == sizeof(*header) &&
+	                memcmp(header->magic, kMagic, sizeof(kMagic)) == 0;
+	close(fd);
+	return ok;
+}
+
+// Returns nullptr if the file does not exist or does not hold the icon of
+// the current version of the package.
+SDL_Surface *ReadIcon(const std::string &file, const std::string &name,
+                      const struct stat &st, bool alpha) {
+	const int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return nullptr;
+	struct stat file_st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &file_st) == 0 &&
+	    static_cast<std::size_t>(file_st.st_size) >= sizeof(Header)) {
+		data = mmap(nullptr, file_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (data == MAP_FAILED) return nullptr;
+
+	const auto *bytes = static_cast<const char *>(data);
+	const std::size_t size = file_st.st_size;
+	Header header;
+	memcpy(&header, bytes, sizeof(header));
+	SDL_Surface *surface = nullptr;
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+	    header.version == kVersion && SamePackage(header, st) &&
+	    (header.flags & kFlagAlpha) == (alpha ? kFlagAlpha : 0) &&
+	    header.width <= kMaxDimension && header.height <= kMaxDimension &&
+	    header.name_length == name.size() &&
+	    size == sizeof(header) + name.size() +
+	                std::size_t(header.width) * header.height * 4 &&
+	    memcmp(bytes + sizeof(header), name.data(), name.size()) == 0) {
+		surface = SDL_CreateRGBSurface(
+		    SDL_SWSURFACE | SDL_SRCALPHA, header.width, header.height, 32,
+		    0x00FF0000, 0x0000FF00, 0x000000FF, alpha ? 0xFF000000 : 0);
+	}
+	if (surface) {
+		const char *pixels = bytes + sizeof(header) + name.size();
+		for (int y = 0; y < surface->h; ++y) {
+			memcpy(static_cast<char *>(surface->pixels) + y * surface->pitch,
+			       pixels + y * surface->w * 4, surface->w * 4);
+		}
+	}
+	munmap(data, size);
+	return surface;
+}
+
+std::string Serialize(const std::string &name, const struct stat &st,
+                      SDL_Surface *surface, bool alpha) {
+	Header header;
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.dev = st.st_dev;
+	header.ino = st.st_ino;
+	header.mtime_sec = st.st_mtim.tv_sec;
+	header.mtime_nsec = st.st_mtim.tv_nsec;
+	header.size = st.st_size;
+	header.width = surface->w;
+	header.height = surface->h;
+	header.flags = alpha ? kFlagAlpha : 0;
+	header.name_length = name.size();
+
+	std::string data;
+	data.reserve(sizeof(header) + name.size() + surface->w * surface->h * 4);
+	data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+	data += name;
+	for (int y = 0; y < surface->h; ++y) {
+		data.append(static_cast<const char *>(surface->pixels) +
+		                y * surface->pitch,
+		            surface->w * 4);
+	}
+	return data;
+}
+
+// Calls `fn(path)` for the cached icons of the given package.
+template <typename F>
+void ForEachFile(const std::string &dir, const std::string &package, F fn) {
+	const std::string prefix = FilePrefix(package);
+	DIR *dirp = opendir(dir.c_str());
+	if (!dirp) return;
+	while (struct dirent *dent = readdir(dirp)) {
+		if (strncmp(dent->d_name, prefix.c_str(), prefix.size()) != 0) continue;
+		// Skip temporary files of interrupted writes.
+		if (dent->d_name[strlen(dent->d_name) - 1] == '~') continue;
+		fn(dir + "/" + dent->d_name);
+	}
+	closedir(dirp);
+}
+
+}  // namespace
+
+OpkIconCache &OpkIconCache::instance() {
+	static OpkIconCache cache;
+	return cache;
+}
+
+OpkIconCache::OpkIconCache() : dir_(GMenu2X::getHome() + "/cache/opkicons") {}
+
+SDL_Surface *OpkIconCache::Load(const std::string &package,
+                                const std::string &icon, bool alpha) {
+	static_assert(sizeof(Header) == 64, "unexpected padding in Header");
+
+	struct stat st;
+	if (stat(package.c_str(), &st) != 0) {
+		ERROR("Unable to open OPK %s\n", package.c_str());
+		return nullptr;
+	}
+
+	const std::string name = package + '#' + icon;
+	const std::string file = dir_ + "/" + FileName(package, icon, st, alpha);
+	if (SDL_Surface *cached = ReadIcon(file, name, st, alpha)) return cached;
+
+	SDL_Surface *surface = readPNG(name, alpha);
+	if (!surface) return nullptr;
+	Store(file, Serialize(name, st, surface, alpha));
+	return surface;
+}
+
+void OpkIconCache::Store(const std::string &file, const std::string &data) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!dir_created_) {
+		std::error_code ec;
+		compat::filesystem::create_directories(dir_, ec);
+		dir_created_ = true;
+	}
+	if (!writeStringToFile(file, data, false))
+		WARNING("Unable to write package icon '%s'\n", file.c_str());
+}
+
+void OpkIconCache::RemoveStale(const std::vector<std::string> &packages) {
+	std::unordered_map<std::string, struct stat> current;
+	for (const std::string &package : packages) {
+		struct stat st;
+		if (stat(package.c_str(), &st) == 0) current[FilePrefix(package)] = st;
+	}
+	if (current.empty()) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	DIR *dirp = opendir(dir_.c_str());
+	if (!dirp) return;
+	while (struct dirent *dent = readdir(dirp)) {
+		const char *dash = strchr(dent->d_name, '-');
+		if (!dash) continue;
+		auto it = current.find(std::string(dent->d_name, dash - dent->d_name + 1));
+		if (it == current.end()) continue;
+		const std::string path = dir_ + "/" + dent->d_name;
+		Header header;
+		if (ReadHeader(path, &header) && !SamePackage(header, it->second)) {
+			DEBUG("Removing stale package icon '%s'\n", path.c_str());
+			unlink(path.c_str());
+		}
+	}
+	closedir(dirp);
+}
+
+void OpkIconCache::Remove(const std::string &package) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	ForEachFile(dir_, package, [](const std::string &path) {
+		unlink(path.c_str());
+	});
+}
@@ -0,0 +1,50 @@
+#ifndef _OPK_ICON_CACHE_H_
+#define _OPK_ICON_CACHE_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct SDL_Surface;
+
+// Icons extracted from packages, kept decoded under ~/.gmenu2x/cache/opkicons
+// so that loading an icon again does not have to open the package.
+//
+// An icon is stored as raw 32-bit pixels and read back through mmap. It is
+// keyed by the inode, modification time and size of the package and by the
+// name of the icon, so a replaced package gets new entries; the stale ones
+// are removed by RemoveStale() after a batch of packages is loaded, or when
+// the package is removed. Icons are not synced to disk, since they can be
+// extracted again.
+//
+// May be used from any thread.
+class OpkIconCache {
+ public:
+	static OpkIconCache &instance();
+
+	OpkIconCache(const OpkIconCache &) = delete;
+	OpkIconCache &operator=(const OpkIconCache &) = delete;
+
+	// Returns the icon with the given name from the package at `package`,
+	// as a newly allocated 32bpp surface, or nullptr if it cannot be loaded.
+	SDL_Surface *Load(const std::string &package, const std::string &icon,
+	                  bool alpha);
+
+	// Removes the cached icons of a package that no longer exists.
+	void Remove(const std::string &package);
+
+	// Removes the cached icons of older versions of the given packages,
+	// reading the cache directory once for all of them.
+	void RemoveStale(const std::vector<std::string> &packages);
+
+ private:
+	OpkIconCache();
+
+	void Store(const std::string &file, const std::string &data);
+
+	const std::string dir_;
+	bool dir_created_ = false;
+	std::mutex mutex_;
+};
+
+#endif  // _OPK_ICON_CACHE_H_
@@ -0,0 +1,47 @@
+#ifndef _PARALLEL_SORT_H_
+#define _PARALLEL_SORT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// Lists shorter than this are sorted on the calling thread, since starting
+// threads costs more than it saves.
+constexpr std::size_t kParallelSortThreshold = 16384;
+
+// Sorts [first, last) like std::sort, splitting large ranges over the
+// available cores: the parts are sorted by threads of their own and then
+// merged pairwise.
+template <typename RandomIt, typename Compare>
+void ParallelSort(RandomIt first, RandomIt last, Compare comp) {
+	const std::size_t size = last - first;
+	std::size_t parts = std::min(std::thread::hardware_concurrency(), 4u);
+	if (size < kParallelSortThreshold || parts < 2) {
+		std::sort(first, last, comp);
+		return;
+	}
+
+	std::vector<RandomIt> bounds;
+	for (std::size_t i = 0; i <= parts; ++i)
+		bounds.push_back(first + size * i / parts);
+
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < parts; ++i) {
+		threads.emplace_back([&bounds, &comp, i]() {
+			std::sort(bounds[i], bounds[i + 1], comp);
+		});
+	}
+	std::sort(bounds[0], bounds[1], comp);
+	for (std::thread &thread : threads) thread.join();
+
+	for (std::size_t step = 1; step < parts; step *= 2) {
+		for (std::size_t i = 0; i + step < parts; i += 2 * step) {
+			std::inplace_merge(bounds[i], bounds[i + step],
+			                   bounds[std::min(i + 2 * step, parts)], comp);
+		}
+	}
+}
+
+#endif  // _PARALLEL_SORT_H_
@@ -0,0 +1,115 @@
+#include "preview_loader.h"
+
+#include <algorithm>
+
+#include "dir_listing_cache.h"
+#include "surface.h"
+#include "thumbnail_cache.h"
+#include "utilities.h"
+
+namespace {
+
+// Enough for the selection plus what is prefetched around it, twice, so that
+// scrolling back and forth does not decode anything again.
+constexpr std::size_t kMaxCachedPreviews = 12;
+
+}  // namespace
+
+PreviewLoader::PreviewLoader(int max_width, int max_height)
+    : max_width_(max_width),
+      max_height_(max_height),
+      thread_(&PreviewLoader::Run, this) {}
+
+PreviewLoader::~PreviewLoader() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	cond_.notify_all();
+	thread_.join();
+}
+
+void PreviewLoader::SetDirectory(const std::string &dir) {
+	if (dir == dir_ && listing_) return;
+	// Looking the previews up in one listing is much cheaper than failing to
+	// open each of them on a slow card.
+	listing_ = DirListingCache::instance().Get(dir);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	dir_ = dir;
+	queue_.clear();
+	cache_.clear();
+	wanted_.clear();
+	++generation_;
+}
+
+bool PreviewLoader::Has(compat::string_view name) const {
+	return listing_ && listing_->files.Find(name) >= 0;
+}
+
+void PreviewLoader::Request(const std::vector<std::string> &names) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queue_.clear();
+		wanted_ = names.empty() ? std::string() : names.front();
+		// Touch in reverse so that the most wanted previews are evicted last.
+		for (auto it = names.rbegin(); it != names.rend(); ++it) {
+			auto cached = cache_.find(*it);
+			if (cached != cache_.end()) {
+				cached->second.last_used = ++clock_;
+			} else if (Has(*it)) {
+				queue_.push_front(*it);
+			}
+		}
+	}
+	cond_.notify_one();
+}
+
+std::shared_ptr<OffscreenSurface> PreviewLoader::Find(
+    compat::string_view name) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = cache_.find(std::string(name.data(), name.size()));
+	if (it == cache_.end()) return nullptr;
+	Cached &cached = it->second;
+	if (cached.surface && !cached.converted) {
+		cached.surface->convertToDisplayFormat();
+		cached.converted = true;
+	}
+	return cached.surface;
+}
+
+void PreviewLoader::Run() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;) {
+		cond_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+		if (quit_) return;
+
+		std::string name = std::move(queue_.front());
+		queue_.pop_front();
+		if (cache_.count(name)) continue;
+
+		const std::string path = dir_ + name;
+		const std::uint64_t generation = generation_;
+		lock.unlock();
+		std::shared_ptr<OffscreenSurface> surface =
+		    ThumbnailCache::instance().Get(path, max_width_, max_height_);
+		lock.lock();
+
+		if (generation != generation_) continue;
+		// Failed previews are cached too, so they are not tried again.
+		cache_[name] = Cached{std::move(surface), ++clock_, false};
+		Evict();
+		if (name == wanted_) request_repaint();
+	}
+}
+
+void PreviewLoader::Evict() {
+	while (cache_.size() > kMaxCachedPreviews) {
+		cache_.erase(std::min_element(
+		    cache_.begin(), cache_.end(),
+		    [](const std::pair<const std::string, Cached> &a,
+		       const std::pair<const std::string, Cached> &b) {
+			    return a.second.last_used < b.second.last_used;
+		    }));
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef _PREVIEW_LOADER_H_
+#define _PREVIEW_LOADER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "compat-string_view.h"
+
+struct DirListing;
+class OffscreenSurface;
+
+// Decodes the preview images of a selector directory in a background thread,
+// so that scrolling through a list never waits for a PNG to be read.
+//
+// Previews are named by their file in the previews directory; the preview of
+// an entry named "foo.ext" is usually "foo.png". Previews are read through
+// the thumbnail cache, scaled down to the given bounds.
+class PreviewLoader {
+ public:
+	PreviewLoader(int max_width, int max_height);
+
+	PreviewLoader(const PreviewLoader &) = delete;
+	PreviewLoader &operator=(const PreviewLoader &) = delete;
+
+	// Waits for the preview being decoded, if any.
+	~PreviewLoader();
+
+	// Switches to the previews in the given directory. Which previews exist
+	// is learned from a single listing of that directory.
+	void SetDirectory(const std::string &dir);
+
+	// Returns true if the given preview exists.
+	bool Has(compat::string_view name) const;
+
+	// Replaces the queue of previews to decode with the given ones, most
+	// wanted first. Previews that are no longer wanted are not decoded.
+	void Request(const std::vector<std::string> &names);
+
+	// Returns the given preview decoded, in display format, or nullptr if it
+	// does not exist or is not decoded yet.
+	std::shared_ptr<OffscreenSurface> Find(compat::string_view name);
+
+ private:
+	struct Cached {
+		std::shared_ptr<OffscreenSurface> surface;
+		std::uint64_t last_used;
+		bool converted;  // to display format, which the worker cannot do
+	};
+
+	void Run();
+	void Evict();
+
+	const int max_width_, max_height_;
+	std::string dir_;
+	std::shared_ptr<const DirListing> listing_;  // of dir_
+
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::deque<std::string> queue_;
+	std::unordered_map<std::string, Cached> cache_;
+	std::string wanted_;  // first preview of the last request
+	std::uint64_t generation_ = 0;  // incremented when dir_ changes
+	std::uint64_t clock_ = 0;
+	bool quit_ = false;
+
+	std::thread thread_;
+};
+
+#endif  // _PREVIEW_LOADER_H_
@@ -0,0 +1,266 @@
+#include "rom_metadata.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "compat-filesystem.h"
+#include "debug.h"
+#include "gmenu2x.h"
+#include "utilities.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'G', '2', 'X', 'M'};
+constexpr std::uint32_t kVersion = 1;
+constexpr char kSidecarName[] = ".metadata.ini";
+
+struct Header {
+	char magic[4];  // "G2XM"
+	std::uint32_t version;
+	// Of the sidecar the index was compiled from.
+	std::int64_t mtime_sec;
+	std::int64_t mtime_nsec;
+	std::uint64_t sidecar_size;
+	std::uint32_t path_length;  // of the directory
+	std::uint32_t count;
+	std::uint32_t records_offset;
+	std::uint32_t strings_offset;
+	std::uint32_t strings_size;
+	std::uint32_t padding;
+	// Followed by the path of the directory, then by `count` records sorted
+	// by file name at `records_offset`, then by the strings they point into
+	// at `strings_offset`.
+};
+
+struct Parsed {
+	std::string file, name, description, preview;
+};
+
+std::string CompiledPath(const std::string &dir) {
+	// FNV-1a; collisions are caught by the path stored in the index.
+	std::uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : dir) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	char name[18];
+	snprintf(name, sizeof(name), "/%016llx",
+	         static_cast<unsigned long long>(hash));
+	return GMenu2X::getHome() + "/cache/metadata" + name;
+}
+
+std::vector<Parsed> ParseSidecar(const std::string &path) {
+	std::vector<Parsed> entries;
+	std::ifstream in(path);
+	std::string line;
+	while (std::getline(in, line)) {
+		line = trim(line);
+		if (line.empty() || line[0] == '#' || line[0] == ';') continue;
+		if (line[0] == '[' && line.back() == ']') {
+			entries.push_back(Parsed{line.substr(1, line.size() - 2), "", "", ""});
+			continue;
+		}
+		const std::string::size_type pos = line.find('=');
+		if (entries.empty() || pos == std::string::npos) {
+			WARNING("Ignoring line in '%s': %s\n", path.c_str(), line.c_str());
+			continue;
+		}
+		const std::string key = trim(line.substr(0, pos));
+		std::string value = trim(line.substr(pos + 1));
+		Parsed &entry = entries.back();
+		if (key == "name") {
+			entry.name = std::move(value);
+		} else if (key == "description") {
+			entry.description = std::move(value);
+		} else if (key == "preview") {
+			entry.preview = std::move(value);
+		} else {
+			WARNING("Unknown key '%s' in '%s'\n", key.c_str(), path.c_str());
+		}
+	}
+
+	// The last section of a file wins.
+	std::stable_sort(entries.begin(), entries.end(),
+	                 [](const Parsed &a, const Parsed &b) {
+		                 return a.file < b.file;
+	                 });
+	std::vector<Parsed> unique;
+	for (std::size_t i = 0; i < entries.size(); ++i) {
+		if (i + 1 < entries.size() && entries[i + 1].file == entries[i].file)
+			continue;
+		unique.push_back(std::move(entries[i]));
+	}
+	return unique;
+}
+
+}  // namespace
+
+struct RomMetadata::Record {
+	std::uint32_t file, file_length;
+	std::uint32_t name, name_length;
+	std::uint32_t description, description_length;
+	std::uint32_t preview, preview_length;
+};
+
+std::string RomMetadata::Compile(const std::string &dir,
+                                 const std::string &sidecar_path,
+                                 const struct stat &sidecar) {
+	const std::vector<Parsed> entries = ParseSidecar(sidecar_path);
+
+	std::string strings;
+	std::vector<Record> records;
+	records.reserve(entries.size());
+	auto add = [&strings](const std::string &value, std::uint32_t *offset,
+	                      std::uint32_t *length) {
+		*offset = strings.size();
+		*length = value.size();
+		strings += value;
+	};
+	for (const Parsed &entry : entries) {
+		Record record;
+		add(entry.file, &record.file, &record.file_length);
+		add(entry.name, &record.name, &record.name_length);
+		add(entry.description, &record.description, &record.description_length);
+		add(entry.preview, &record.preview, &record.preview_length);
+		records.push_back(record);
+	}
+
+	Header header;
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.mtime_sec = sidecar.st_mtim.tv_sec;
+	header.mtime_nsec = sidecar.st_mtim.tv_nsec;
+	header.sidecar_size = sidecar.st_size;
+	header.path_length = dir.size();
+	header.count = records.size();
+	// Records are read in place, so they must be aligned.
+	header.records_offset = (sizeof(Header) + dir.size() + 3) & ~3u;
+	header.strings_offset =
+	    header.records_offset + records.size() * sizeof(Record);
+	header.strings_size = strings.size();
+	header.padding = 0;
+
+	std::string data(reinterpret_cast<const char *>(&header), sizeof(header));
+	data += dir;
+	data.resize(header.records_offset, '\0');
+	data.append(reinterpret_cast<const char *>(records.data()),
+	            records.size() * sizeof(Record));
+	data += strings;
+	return data;
+}
+
+std::shared_ptr<const RomMetadata> RomMetadata::Open(const std::string &dir) {
+	std::string key = dir;
+	while (key.size() > 1 && key.back() == '/') key.pop_back();
+	const std::string sidecar_path = key + "/" + kSidecarName;
+	struct stat sidecar;
+	if (stat(sidecar_path.c_str(), &sidecar) != 0) return nullptr;
+
+	std::shared_ptr<RomMetadata> metadata(new RomMetadata());
+	const std::string compiled = CompiledPath(key);
+	if (metadata->Map(compiled) && metadata->Matches(key, sidecar))
+		return metadata;
+	metadata->Unmap();
+
+	std::string data = Compile(key, sidecar_path, sidecar);
+	std::error_code ec;
+	compat::filesystem::create_directories(parentDir(compiled), ec);
+	// Not synced: a compiled index that is cut short by a crash fails
+	// Matches(), and the sidecar is compiled again.
+	if (writeStringToFile(compiled, data, false) && metadata->Map(compiled) &&
+	    metadata->Matches(key, sidecar)) {
+		return metadata;
+	}
+	metadata->Unmap();
+
+	WARNING("Unable to store compiled metadata of '%s'\n", key.c_str());
+	metadata->buffer_ = std::move(data);
+	metadata->data_ = metadata->buffer_.data();
+	metadata->size_ = metadata->buffer_.size();
+	return metadata;
+}
+
+RomMetadata::~RomMetadata() {
+	Unmap();
+}
+
+bool RomMetadata::Map(const std::string &path) {
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return false;
+	struct stat st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (data == MAP_FAILED) return false;
+	data_ = static_cast<const char *>(data);
+	size_ = st.st_size;
+	mapped_ = true;
+	return true;
+}
+
+void RomMetadata::Unmap() {
+	if (mapped_) munmap(const_cast<char *>(data_), size_);
+	data_ = nullptr;
+	size_ = 0;
+	mapped_ = false;
+}
+
+bool RomMetadata::Matches(const std::string &dir,
+                          const struct stat &sidecar) const {
+	if (size_ < sizeof(Header)) return false;
+	const Header &header = *reinterpret_cast<const Header *>(data_);
+	return memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+	       header.version == kVersion &&
+	       header.mtime_sec == sidecar.st_mtim.tv_sec &&
+	       header.mtime_nsec == sidecar.st_mtim.tv_nsec &&
+	       header.sidecar_size == static_cast<std::uint64_t>(sidecar.st_size) &&
+	       header.path_length == dir.size() &&
+	       sizeof(Header) + dir.size() <= size_ &&
+	       memcmp(data_ + sizeof(Header), dir.data(), dir.size()) == 0 &&
+	       header.records_offset % 4 == 0 &&
+	       header.records_offset <= size_ &&
+	       header.count <= (size_ - header.records_offset) / sizeof(Record) &&
+	       header.strings_offset <= size_ &&
+	       header.strings_size <= size_ - header.strings_offset;
+}
+
+std::size_t RomMetadata::size() const {
+	return reinterpret_cast<const Header *>(data_)->count;
+}
+
+const RomMetadata::Record *RomMetadata::records() const {
+	return reinterpret_cast<const Record *>(
+	    data_ + reinterpret_cast<const Header *>(data_)->records_offset);
+}
+
+compat::string_view RomMetadata::String(std::uint32_t offset,
+                                        std::uint32_t length) const {
+	const Header &header = *reinterpret_cast<const Header *>(data_);
+	if (offset > header.strings_size || length > header.strings_size - offset)
+		return compat::string_view();
+	return compat::string_view(data_ + header.strings_offset + offset, length);
+}
+
+bool RomMetadata::Find(compat::string_view file, Info *info) const {
+	const Record *begin = records();
+	const Record *end = begin + size();
+	const Record *it = std::lower_bound(
+	    begin, end, file, [this](const Record &record, compat::string_view file) {
+		    return String(record.file, record.file_length) < file;
+	    });
+	if (it == end || String(it->file, it->file_length) != file) return false;
+	info->name = String(it->name, it->name_length);
+	info->description = String(it->description, it->description_length);
+	info->preview = String(it->preview, it->preview_length);
+	return true;
+}
@@ -0,0 +1,75 @@
+#ifndef _ROM_METADATA_H_
+#define _ROM_METADATA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sys/stat.h>
+
+#include "compat-string_view.h"
+
+// Display names, descriptions and previews for the files of a selector
+// directory, from a ".metadata.ini" sidecar file in that directory:
+//
+//   [Super Mario Land (World).gb]
+//   name=Super Mario Land
+//   description=Platformer, 1989
+//   preview=Super Mario Land.png
+//
+// A preview is a file name in the "previews" subdirectory, so that several
+// files can share one. Lines starting with '#' or ';' are comments.
+//
+// The sidecar is compiled into a binary index under
+// ~/.gmenu2x/cache/metadata the first time it is used, and again only when
+// it changes. The index is mapped into memory and searched in place, so
+// opening a directory does not parse any text.
+class RomMetadata {
+ public:
+	struct Info {
+		compat::string_view name;  // empty if not given
+		compat::string_view description;
+		compat::string_view preview;
+	};
+
+	// Returns the metadata of the given directory, compiling its sidecar if
+	// needed, or nullptr if it has none.
+	static std::shared_ptr<const RomMetadata> Open(const std::string &dir);
+
+	RomMetadata(const RomMetadata &) = delete;
+	RomMetadata &operator=(const RomMetadata &) = delete;
+	~RomMetadata();
+
+	// Looks up the metadata of the file with the given name. Returns false
+	// if there is none. The views are valid as long as this object.
+	bool Find(compat::string_view file, Info *info) const;
+
+	// Number of files that have metadata.
+	std::size_t size() const;
+
+ private:
+	struct Record;
+
+	RomMetadata() = default;
+
+	static std::string Compile(const std::string &dir,
+	                           const std::string &sidecar_path,
+	                           const struct stat &sidecar);
+	bool Map(const std::string &path);
+	void Unmap();
+	// Checks the index and that it was compiled from the given sidecar.
+	bool Matches(const std::string &dir, const struct stat &sidecar) const;
+	compat::string_view String(std::uint32_t offset,
+	                           std::uint32_t length) const;
+	const Record *records() const;
+
+	// Either mapped from the compiled file or, if that could not be written,
+	// held in `buffer_`.
+	const char *data_ = nullptr;
+	std::size_t size_ = 0;
+	bool mapped_ = false;
+	std::string buffer_;
+};
+
+#endif  // _ROM_METADATA_H_
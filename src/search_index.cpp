@@ -0,0 +1,420 @@
+#include "search_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#include "debug.h"
+#include "utilities.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'G', '2', 'X', 'S'};
+constexpr std::uint32_t kVersion = 1;
+
+std::string Fold(const std::string &text) {
+	std::string folded = text;
+	for (char &c : folded) {
+		if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+	}
+	return folded;
+}
+
+std::uint32_t Trigram(const char *p) {
+	return static_cast<std::uint32_t>(static_cast<unsigned char>(p[0])) << 16 |
+	       static_cast<std::uint32_t>(static_cast<unsigned char>(p[1])) << 8 |
+	       static_cast<unsigned char>(p[2]);
+}
+
+// Returns the distinct trigrams of `folded`, except those that span the
+// separator between the title and the text.
+std::vector<std::uint32_t> Trigrams(const std::string &folded) {
+	std::vector<std::uint32_t> trigrams;
+	for (std::size_t i = 0; i + 3 <= folded.size(); ++i) {
+		if (folded[i] == '\n' || folded[i + 1] == '\n' || folded[i + 2] == '\n')
+			continue;
+		trigrams.push_back(Trigram(&folded[i]));
+	}
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+	               trigrams.end());
+	return trigrams;
+}
+
+bool IsWordStart(const std::string &folded, std::size_t pos) {
+	if (pos == 0) return true;
+	const unsigned char c = folded[pos - 1];
+	return !(c >= 'a' && c <= 'z') && !(c >= '0' && c <= '9') && c < 0x80;
+}
+
+class Writer {
+ public:
+	void U8(std::uint8_t value) { data_.push_back(value); }
+	void U32(std::uint32_t value) {
+		data_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+	void String(const std::string &value) {
+		U32(value.size());
+		data_ += value;
+	}
+	void Bytes(const void *data, std::size_t size) {
+		data_.append(static_cast<const char *>(data), size);
+	}
+	const std::string &data() const { return data_; }
+
+ private:
+	std::string data_;
+};
+
+// Reads values from a buffer; any read past the end sets `ok()` to false.
+class Reader {
+ public:
+	explicit Reader(const std::string &data) : data_(data) {}
+
+	std::uint8_t U8() {
+		std::uint8_t value = 0;
+		Bytes(&value, sizeof(value));
+		return value;
+	}
+	std::uint32_t U32() {
+		std::uint32_t value = 0;
+		Bytes(&value, sizeof(value));
+		return value;
+	}
+	std::string String() {
+		const std::uint32_t size = U32();
+		if (!ok_ || data_.size() - pos_ < size) {
+			ok_ = false;
+			return std::string();
+		}
+		std::string value = data_.substr(pos_, size);
+		pos_ += size;
+		return value;
+	}
+	void Bytes(void *out, std::size_t size) {
+		if (!ok_ || data_.size() - pos_ < size) {
+			ok_ = false;
+			return;
+		}
+		memcpy(out, data_.data() + pos_, size);
+		pos_ += size;
+	}
+	// Guards against allocating huge amounts for a corrupt count.
+	bool Fits(std::uint32_t count, std::size_t min_size) {
+		ok_ = ok_ && count <= (data_.size() - pos_) / min_size;
+		return ok_;
+	}
+	bool ok() const { return ok_; }
+
+ private:
+	const std::string &data_;
+	std::size_t pos_ = 0;
+	bool ok_ = true;
+};
+
+}  // namespace
+
+SearchIndex::SearchIndex(std::string path) : path_(std::move(path)) {}
+
+std::size_t SearchIndex::size() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return entries_.size() - dead_;
+}
+
+std::string SearchIndex::GetStamp(const std::string &source) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = sources_.find(source);
+	return it == sources_.end() ? std::string() : it->second.stamp;
+}
+
+std::uint32_t SearchIndex::SourceId(const std::string &source) {
+	auto it = std::find(source_names_.begin(), source_names_.end(), source);
+	if (it != source_names_.end()) return it - source_names_.begin();
+	source_names_.push_back(source);
+	return source_names_.size() - 1;
+}
+
+void SearchIndex::Add(std::uint32_t source, Document &&document) {
+	const std::uint32_t index = entries_.size();
+	Entry entry;
+	entry.folded = Fold(document.title) + '\n' + Fold(document.text);
+	entry.document = std::move(document);
+	entry.source = source;
+	entry.live = true;
+	for (std::uint32_t trigram : Trigrams(entry.folded))
+		postings_[trigram].push_back(index);
+	sources_[source_names_[source]].entries.push_back(index);
+	entries_.push_back(std::move(entry));
+}
+
+void SearchIndex::Remove(const std::string &source) {
+	auto it = sources_.find(source);
+	if (it == sources_.end()) return;
+	for (std::uint32_t index : it->second.entries) entries_[index].live = false;
+	dead_ += it->second.entries.size();
+	sources_.erase(it);
+}
+
+void SearchIndex::Compact() {
+	std::vector<Entry> entries;
+	entries.reserve(entries_.size() - dead_);
+	std::vector<std::string> names;
+	for (auto &source : sources_) {
+		const std::uint32_t id = names.size();
+		names.push_back(source.first);
+		std::vector<std::uint32_t> indices;
+		indices.reserve(source.second.entries.size());
+		for (std::uint32_t index : source.second.entries) {
+			indices.push_back(entries.size());
+			entries.push_back(std::move(entries_[index]));
+			entries.back().source = id;
+		}
+		source.second.entries = std::move(indices);
+	}
+
+	postings_.clear();
+	for (std::uint32_t index = 0; index < entries.size(); ++index) {
+		for (std::uint32_t trigram : Trigrams(entries[index].folded))
+			postings_[trigram].push_back(index);
+	}
+	// Entries are ordered by source, so the postings have to be sorted.
+	for (auto &posting : postings_)
+		std::sort(posting.second.begin(), posting.second.end());
+
+	entries_ = std::move(entries);
+	source_names_ = std::move(names);
+	dead_ = 0;
+}
+
+void SearchIndex::Replace(const std::string &source, const std::string &stamp,
+                          std::vector<Document> documents) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	Remove(source);
+	const std::uint32_t id = SourceId(source);
+	sources_[source].stamp = stamp;
+	for (Document &document : documents) Add(id, std::move(document));
+	if (dead_ > entries_.size() / 2) Compact();
+	dirty_ = true;
+}
+
+void SearchIndex::Retain(const std::set<std::string> &sources) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<std::string> stale;
+	for (const auto &source : sources_) {
+		if (!sources.count(source.first)) stale.push_back(source.first);
+	}
+	for (const std::string &source : stale) Remove(source);
+	if (!stale.empty()) {
+		if (dead_ > entries_.size() / 2) Compact();
+		dirty_ = true;
+	}
+}
+
+std::vector<SearchIndex::Document> SearchIndex::Search(
+    const std::string &query, std::size_t max_results,
+    std::chrono::milliseconds budget, bool *complete) const {
+	const auto deadline = std::chrono::steady_clock::now() + budget;
+	*complete = true;
+
+	std::vector<Document> results;
+	const std::string needle = Fold(query);
+	if (needle.empty() || max_results == 0) return results;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// Candidates are the entries that contain every trigram of the query;
+	// queries that are too short for that are matched against everything.
+	const bool scan_all = needle.size() < 3;
+	std::vector<std::uint32_t> candidates;
+	if (!scan_all) {
+		std::vector<const std::vector<std::uint32_t> *> lists;
+		for (std::uint32_t trigram : Trigrams(needle)) {
+			auto it = postings_.find(trigram);
+			if (it == postings_.end()) return results;
+			lists.push_back(&it->second);
+		}
+		std::sort(lists.begin(), lists.end(),
+		          [](const std::vector<std::uint32_t> *a,
+		             const std::vector<std::uint32_t> *b) {
+			          return a->size() < b->size();
+		          });
+		candidates = *lists.front();
+		std::vector<std::uint32_t> intersection;
+		for (std::size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+			intersection.clear();
+			std::set_intersection(candidates.begin(), candidates.end(),
+			                      lists[i]->begin(), lists[i]->end(),
+			                      std::back_inserter(intersection));
+			candidates.swap(intersection);
+		}
+	}
+
+	struct Scored {
+		int score;
+		std::uint32_t index;
+	};
+	std::vector<Scored> scored;
+	const std::size_t count = scan_all ? entries_.size() : candidates.size();
+	for (std::size_t i = 0; i < count; ++i) {
+		if ((i & 1023) == 1023 && std::chrono::steady_clock::now() > deadline) {
+			*complete = false;
+			break;
+		}
+		const std::uint32_t index = scan_all ? i : candidates[i];
+		const Entry &entry = entries_[index];
+		if (!entry.live) continue;
+		// Trigrams can match in a different order, so check the text.
+		const std::size_t pos = entry.folded.find(needle);
+		if (pos == std::string::npos) continue;
+
+		// Prefer title prefixes, then word starts in the title, then other
+		// title matches, then description matches; links before files and
+		// short titles before long ones.
+		const std::size_t title_size = entry.document.title.size();
+		int rank = pos == 0 ? 3
+		           : pos < title_size ? (IsWordStart(entry.folded, pos) ? 2 : 1)
+		                              : 0;
+		rank = rank * 2 + (entry.document.kind == Kind::kLink ? 1 : 0);
+		const int score =
+		    rank * 256 - static_cast<int>(std::min<std::size_t>(title_size, 255));
+		scored.push_back(Scored{score, index});
+	}
+
+	const std::size_t n = std::min(max_results, scored.size());
+	std::partial_sort(scored.begin(), scored.begin() + n, scored.end(),
+	                  [](const Scored &a, const Scored &b) {
+		                  return a.score != b.score ? a.score > b.score
+		                                            : a.index < b.index;
+	                  });
+	results.reserve(n);
+	for (std::size_t i = 0; i < n; ++i)
+		results.push_back(entries_[scored[i].index].document);
+	return results;
+}
+
+bool SearchIndex::Load() {
+	std::ifstream in(path_, std::ios::in | std::ios::binary);
+	if (!in) return false;
+	const std::string data((std::istreambuf_iterator<char>(in)),
+	                       std::istreambuf_iterator<char>());
+
+	Reader reader(data);
+	char magic[4];
+	reader.Bytes(magic, sizeof(magic));
+	if (!reader.ok() || memcmp(magic, kMagic, sizeof(magic)) != 0 ||
+	    reader.U32() != kVersion) {
+		WARNING("Ignoring search index '%s' of another version\n",
+		        path_.c_str());
+		return false;
+	}
+
+	std::vector<std::string> names;
+	std::map<std::string, Source> sources;
+	const std::uint32_t num_sources = reader.U32();
+	if (reader.Fits(num_sources, 8)) {
+		for (std::uint32_t i = 0; i < num_sources && reader.ok(); ++i) {
+			names.push_back(reader.String());
+			sources[names.back()].stamp = reader.String();
+		}
+	}
+
+	std::vector<Entry> entries;
+	const std::uint32_t num_entries = reader.U32();
+	if (reader.Fits(num_entries, 21)) {
+		entries.reserve(num_entries);
+		for (std::uint32_t i = 0; i < num_entries && reader.ok(); ++i) {
+			Entry entry;
+			entry.document.kind = static_cast<Kind>(reader.U8());
+			entry.source = reader.U32();
+			entry.document.title = reader.String();
+			entry.document.text = reader.String();
+			entry.document.target = reader.String();
+			entry.document.owner = reader.String();
+			entry.folded =
+			    Fold(entry.document.title) + '\n' + Fold(entry.document.text);
+			entry.live = true;
+			if (entry.source >= names.size()) break;
+			sources[names[entry.source]].entries.push_back(entries.size());
+			entries.push_back(std::move(entry));
+		}
+	}
+
+	std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postings;
+	const std::uint32_t num_postings = reader.U32();
+	if (reader.Fits(num_postings, 8)) {
+		postings.reserve(num_postings);
+		for (std::uint32_t i = 0; i < num_postings && reader.ok(); ++i) {
+			const std::uint32_t trigram = reader.U32();
+			const std::uint32_t size = reader.U32();
+			if (!reader.Fits(size, 4)) break;
+			std::vector<std::uint32_t> &posting = postings[trigram];
+			posting.resize(size);
+			reader.Bytes(posting.data(), size * 4);
+		}
+	}
+
+	if (!reader.ok() || entries.size() != num_entries) {
+		WARNING("Ignoring corrupt search index '%s'\n", path_.c_str());
+		return false;
+	}
+	for (const auto &posting : postings) {
+		for (std::uint32_t index : posting.second) {
+			if (index >= entries.size()) {
+				WARNING("Ignoring corrupt search index '%s'\n", path_.c_str());
+				return false;
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_ = std::move(entries);
+	postings_ = std::move(postings);
+	sources_ = std::move(sources);
+	source_names_ = std::move(names);
+	dead_ = 0;
+	dirty_ = false;
+	return true;
+}
+
+bool SearchIndex::Save() {
+	Writer writer;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!dirty_) return true;
+		if (dead_ != 0 || source_names_.size() != sources_.size()) Compact();
+
+		writer.Bytes(kMagic, sizeof(kMagic));
+		writer.U32(kVersion);
+		writer.U32(source_names_.size());
+		for (const std::string &name : source_names_) {
+			writer.String(name);
+			writer.String(sources_[name].stamp);
+		}
+		writer.U32(entries_.size());
+		for (const Entry &entry : entries_) {
+			writer.U8(static_cast<std::uint8_t>(entry.document.kind));
+			writer.U32(entry.source);
+			writer.String(entry.document.title);
+			writer.String(entry.document.text);
+			writer.String(entry.document.target);
+			writer.String(entry.document.owner);
+		}
+		writer.U32(postings_.size());
+		for (const auto &posting : postings_) {
+			writer.U32(posting.first);
+			writer.U32(posting.second.size());
+			writer.Bytes(posting.second.data(), posting.second.size() * 4);
+		}
+		dirty_ = false;
+	}
+
+	if (!writeStringToFile(path_, writer.data())) {
+		ERROR("Unable to write search index '%s'\n", path_.c_str());
+		std::lock_guard<std::mutex> lock(mutex_);
+		dirty_ = true;
+		return false;
+	}
+	return true;
+}
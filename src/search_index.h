@@ -0,0 +1,107 @@
+#ifndef _SEARCH_INDEX_H_
+#define _SEARCH_INDEX_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A trigram index over the titles and descriptions of links and files, for
+// finding any of them by a part of its name.
+//
+// Documents are grouped by source, such as the links of the menu or the files
+// of one selector directory. A source is replaced as a whole when it changes,
+// which leaves the documents of the other sources alone.
+//
+// The index is saved to and loaded from a file, so it does not have to be
+// rebuilt from the file system at every start.
+//
+// May be used from any thread.
+class SearchIndex {
+ public:
+	enum class Kind : std::uint8_t {
+		kLink,  // `target` is the link file
+		kFile,  // `target` is the path, `owner` the link file of the app
+	};
+
+	struct Document {
+		Kind kind;
+		std::string title;  // what is shown and ranked on
+		std::string text;   // also searched, but ranked lower
+		std::string target;
+		std::string owner;
+	};
+
+	explicit SearchIndex(std::string path);
+
+	SearchIndex(const SearchIndex &) = delete;
+	SearchIndex &operator=(const SearchIndex &) = delete;
+
+	// Reads the index from its file. Returns false and leaves the index
+	// empty if there is no valid file.
+	bool Load();
+
+	// Writes the index to its file, if it changed since it was loaded or
+	// saved. Returns false on failure.
+	bool Save();
+
+	// Returns the stamp the given source was indexed with, or an empty
+	// string if it is not in the index.
+	std::string GetStamp(const std::string &source) const;
+
+	// Replaces the documents of the given source. The stamp tells the
+	// indexer whether the source has changed since; the index does not
+	// interpret it.
+	void Replace(const std::string &source, const std::string &stamp,
+	             std::vector<Document> documents);
+
+	// Drops every source that is not in `sources`.
+	void Retain(const std::set<std::string> &sources);
+
+	// Returns up to `max_results` documents that contain `query`, ignoring
+	// case, best match first. If checking the candidates takes longer than
+	// `budget`, the best ones found until then are returned and `complete`
+	// is set to false.
+	std::vector<Document> Search(const std::string &query,
+	                             std::size_t max_results,
+	                             std::chrono::milliseconds budget,
+	                             bool *complete) const;
+
+	std::size_t size() const;
+
+ private:
+	struct Entry {
+		Document document;
+		std::string folded;  // lower case title, '\n', lower case text
+		std::uint32_t source;
+		bool live;
+	};
+
+	struct Source {
+		std::string stamp;
+		std::vector<std::uint32_t> entries;
+	};
+
+	void Add(std::uint32_t source, Document &&document);
+	void Remove(const std::string &source);
+	void Compact();
+	std::uint32_t SourceId(const std::string &source);
+
+	const std::string path_;
+
+	mutable std::mutex mutex_;
+	std::vector<Entry> entries_;
+	// Trigram to the ascending indices of the entries that contain it.
+	std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postings_;
+	std::map<std::string, Source> sources_;
+	std::vector<std::string> source_names_;  // by id
+	std::size_t dead_ = 0;
+	bool dirty_ = false;
+};
+
+#endif  // _SEARCH_INDEX_H_
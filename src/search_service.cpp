@@ -0,0 +1,216 @@
+#include "search_service.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <utility>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "compat-filesystem.h"
+#include "debug.h"
+#include "gmenu2x.h"
+#include "linkapp.h"
+#include "menu.h"
+#include "utilities.h"
+
+namespace {
+
+constexpr char kLinksSource[] = "links";
+
+// Limits for crawling a selector directory, in case it points at the root
+// of a huge tree.
+constexpr int kMaxDepth = 8;
+constexpr std::size_t kMaxFilesPerSource = 100000;
+
+std::uint64_t Hash(const std::string &data, std::uint64_t hash) {
+	for (unsigned char c : data) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void AppendStamp(std::string *stamp, const std::string &dir,
+                 const struct stat *st) {
+	char buf[48];
+	snprintf(buf, sizeof(buf), "%" PRId64 ".%ld ",
+	         st ? static_cast<std::int64_t>(st->st_mtim.tv_sec) : 0,
+	         st ? static_cast<long>(st->st_mtim.tv_nsec) : 0L);
+	*stamp += buf;
+	*stamp += dir;
+	*stamp += '\n';
+}
+
+// A crawl stamp lists the directories that were read with their modification
+// times; it is current if none of them changed.
+bool IsCurrent(const std::string &stamp) {
+	std::size_t pos = 0;
+	std::string expected;
+	while (pos < stamp.size()) {
+		std::size_t end = stamp.find('\n', pos);
+		if (end == std::string::npos) end = stamp.size();
+		const std::size_t space = stamp.find(' ', pos);
+		if (space == std::string::npos || space > end) return false;
+		const std::string dir = stamp.substr(space + 1, end - space - 1);
+
+		struct stat st;
+		const bool exists = stat(dir.c_str(), &st) == 0;
+		expected.clear();
+		AppendStamp(&expected, dir, exists ? &st : nullptr);
+		if (stamp.compare(pos, end + 1 - pos, expected) != 0) return false;
+		pos = end + 1;
+	}
+	return true;
+}
+
+bool MatchesExtension(const char *name,
+                      const std::vector<std::string> &extensions) {
+	if (extensions.empty()) return true;
+	const char *dot = strrchr(name, '.');
+	std::string ext = dot ? dot + 1 : "";
+	for (char &c : ext) c = tolower(static_cast<unsigned char>(c));
+	for (const std::string &allowed : extensions) {
+		if (ext == allowed) return true;
+	}
+	return false;
+}
+
+}  // namespace
+
+SearchService::SearchService()
+    : index_(GMenu2X::getHome() + "/cache/search.idx") {}
+
+SearchService::~SearchService() {
+	cancel_ = true;
+	if (thread_.joinable()) thread_.join();
+}
+
+void SearchService::Refresh(Menu &menu) {
+	if (updating_) return;
+	if (thread_.joinable()) thread_.join();
+
+	if (!loaded_) {
+		std::error_code ec;
+		compat::filesystem::create_directories(GMenu2X::getHome() + "/cache",
+		                                       ec);
+		index_.Load();
+		loaded_ = true;
+	}
+
+	std::vector<SearchIndex::Document> links;
+	std::vector<CrawlJob> jobs;
+	std::set<std::string> sources = {kLinksSource};
+	std::uint64_t hash = 14695981039346656037ull;
+	for (std::size_t i = 0; i < menu.getSections().size(); ++i) {
+		for (auto &link : *menu.sectionLinks(i)) {
+			LinkApp *app = LinkApp::from(link.get());
+			if (!app) continue;
+
+			SearchIndex::Document doc;
+			doc.kind = SearchIndex::Kind::kLink;
+			doc.title = app->getTitle();
+			doc.text = app->getDescription();
+#ifdef HAVE_LIBOPK
+			if (app->isOpk()) {
+				doc.text += ' ' + app->getCategory();
+				doc.text += ' ' + app->getOpkFile().substr(
+				                      app->getOpkFile().rfind('/') + 1);
+			}
+#endif
+			doc.target = app->getFile();
+			hash = Hash(doc.title + '\n' + doc.text + '\n' + doc.target + '\n',
+			            hash);
+			links.push_back(std::move(doc));
+
+			const std::string &dir = app->getSelectorDir();
+			if (dir.empty()) continue;
+			CrawlJob job;
+			job.source = "files:" + app->getFile();
+			job.owner = app->getFile();
+			job.dir = dir;
+			// Package links set their directory without the trailing slash
+			// that setSelectorDir() adds.
+			if (job.dir.back() != '/') job.dir += '/';
+			const std::string &filter = app->getSelectorFilter();
+			if (!filter.empty() && filter != "*") {
+				split(job.extensions, case_less::to_lower(filter), ",");
+			}
+			job.recursive = app->getSelectorBrowser();
+			if (sources.insert(job.source).second) jobs.push_back(std::move(job));
+		}
+	}
+
+	char stamp[17];
+	snprintf(stamp, sizeof(stamp), "%016" PRIx64, hash);
+	if (index_.GetStamp(kLinksSource) != stamp) {
+		index_.Replace(kLinksSource, stamp, std::move(links));
+	}
+
+	updating_ = true;
+	cancel_ = false;
+	thread_ = std::thread(&SearchService::Crawl, this, std::move(jobs),
+	                      std::move(sources));
+}
+
+void SearchService::Crawl(std::vector<CrawlJob> jobs,
+                          std::set<std::string> sources) {
+	for (const CrawlJob &job : jobs) {
+		if (cancel_) break;
+		const std::string old_stamp = index_.GetStamp(job.source);
+		if (!old_stamp.empty() && IsCurrent(old_stamp)) continue;
+
+		std::vector<SearchIndex::Document> docs;
+		std::string stamp;
+		// Directories still to read, relative to the selector directory.
+		std::vector<std::pair<std::string, int>> pending = {{"", 0}};
+		while (!pending.empty() && !cancel_ &&
+		       docs.size() < kMaxFilesPerSource) {
+			const std::string rel = std::move(pending.back().first);
+			const int depth = pending.back().second;
+			pending.pop_back();
+			const std::string dir = job.dir + rel;
+
+			struct stat st;
+			AppendStamp(&stamp, dir, stat(dir.c_str(), &st) == 0 ? &st : nullptr);
+			DIR *dirp = opendir(dir.c_str());
+			if (!dirp) continue;
+			while (struct dirent *dent = readdir(dirp)) {
+				if (dent->d_name[0] == '.') continue;
+				bool is_dir = dent->d_type == DT_DIR;
+				bool is_file = dent->d_type == DT_REG;
+				if (dent->d_type == DT_UNKNOWN || dent->d_type == DT_LNK) {
+					struct stat entry_st;
+					if (stat((dir + dent->d_name).c_str(), &entry_st) != 0)
+						continue;
+					is_dir = S_ISDIR(entry_st.st_mode);
+					is_file = S_ISREG(entry_st.st_mode);
+				}
+				if (is_dir) {
+					if (job.recursive && depth < kMaxDepth)
+						pending.emplace_back(rel + dent->d_name + '/', depth + 1);
+				} else if (is_file && MatchesExtension(dent->d_name, job.extensions)) {
+					SearchIndex::Document doc;
+					doc.kind = SearchIndex::Kind::kFile;
+					doc.title = trimExtension(dent->d_name);
+					doc.text = rel;
+					doc.target = dir + dent->d_name;
+					doc.owner = job.owner;
+					docs.push_back(std::move(doc));
+				}
+			}
+			closedir(dirp);
+		}
+		// Keep the old documents if the crawl was interrupted.
+		if (cancel_) break;
+		index_.Replace(job.source, stamp, std::move(docs));
+	}
+
+	if (!cancel_) index_.Retain(sources);
+	index_.Save();
+	updating_ = false;
+	request_repaint();
+}
@@ -0,0 +1,59 @@
+#ifndef _SEARCH_SERVICE_H_
+#define _SEARCH_SERVICE_H_
+
+#include <atomic>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_index.h"
+
+class Menu;
+
+// Keeps a search index of the links of the menu and of the files their
+// selectors show.
+//
+// The links are indexed on the main thread, since they are in memory
+// already. The selector directories are crawled by a background thread,
+// which only reads them again if the modification time of one of their
+// directories changed since they were indexed.
+class SearchService {
+ public:
+	SearchService();
+
+	SearchService(const SearchService &) = delete;
+	SearchService &operator=(const SearchService &) = delete;
+
+	// Stops crawling, keeping what has been indexed so far.
+	~SearchService();
+
+	// Indexes the links of `menu` and starts looking for changes in the
+	// selector directories of its links in the background.
+	// Must be called from the main thread.
+	void Refresh(Menu &menu);
+
+	// True while the background thread is updating the index.
+	bool is_updating() const { return updating_; }
+
+	SearchIndex &index() { return index_; }
+
+ private:
+	struct CrawlJob {
+		std::string source;
+		std::string owner;  // link file of the app
+		std::string dir;
+		std::vector<std::string> extensions;  // lower case; empty for all
+		bool recursive;
+	};
+
+	void Crawl(std::vector<CrawlJob> jobs, std::set<std::string> sources);
+
+	SearchIndex index_;
+	bool loaded_ = false;
+	std::atomic<bool> updating_{false};
+	std::atomic<bool> cancel_{false};
+	std::thread thread_;
+};
+
+#endif  // _SEARCH_SERVICE_H_
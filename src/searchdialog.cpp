@@ -0,0 +1,176 @@
+// Various authors.
+// License: GPL version 2 or later.
+
+#include "searchdialog.h"
+
+#include "gmenu2x.h"
+#include "inputdialog.h"
+#include "search_service.h"
+#include "surface.h"
+
+#include <chrono>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+// Searching must not hold up drawing the frame; if checking the candidates
+// takes longer, the best matches found so far are shown.
+static const chrono::milliseconds SEARCH_BUDGET(15);
+static const size_t MAX_RESULTS = 100;
+
+SearchDialog::SearchDialog(GMenu2X& gmenu2x, SearchService& service)
+	: Dialog(gmenu2x)
+	, service(service)
+	, close(false)
+{
+}
+
+bool SearchDialog::exec() {
+	close = false;
+	while (!close) {
+		InputDialog id(gmenu2x, gmenu2x.input, gmenu2x.tr["Search"], query);
+		if (!id.exec()) {
+			return false;
+		}
+		query = id.getInput();
+		if (showResults()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SearchDialog::showResults() {
+	unsigned int top, height;
+	tie(top, height) = gmenu2x.getContentArea();
+
+	OffscreenSurface bg(*gmenu2x.bg);
+	drawTitleIcon(bg, "icons/explorer.png", true);
+	writeTitle(bg, gmenu2x.tr["Search"]);
+	writeSubTitle(bg, query);
+	int x = 5;
+	x = gmenu2x.drawButton(bg, "accept", gmenu2x.tr.get("Launch"), x);
+	x = gmenu2x.drawButton(bg, "cancel", gmenu2x.tr.get("Edit"), x);
+	x = gmenu2x.drawButton(bg, "start", gmenu2x.tr.get("Exit"), x);
+	(void)x;
+	bg.convertToDisplayFormat();
+
+	const int lineHeight = gmenu2x.font->getLineSpacing();
+	const unsigned int nb_elements = max(height / lineHeight, 1u);
+
+	// Resolve the labels that are drawn every frame once.
+	const string noItems = "(" + string(gmenu2x.tr.get("no items")) + ")";
+	const compat::string_view searching = gmenu2x.tr.get("Searching...");
+
+	vector<SearchIndex::Document> results;
+	bool complete = true, stale = true;
+	unsigned int selected = 0, firstElement = 0;
+
+	while (true) {
+		OutputSurface& s = *gmenu2x.s;
+
+		// The background thread asks for a repaint when it has updated the
+		// index; search again then.
+		if (stale) {
+			stale = false;
+			results = service.index().Search(
+					query, MAX_RESULTS, SEARCH_BUDGET, &complete);
+			if (selected >= results.size()) {
+				selected = results.empty() ? 0 : results.size() - 1;
+			}
+		}
+
+		bg.blit(s, 0, 0);
+
+		if (results.empty()) {
+			gmenu2x.font->write(s, noItems,
+					4, top + lineHeight / 2,
+					Font::HAlignLeft, Font::VAlignMiddle);
+		} else {
+			if (selected >= firstElement + nb_elements)
+				firstElement = selected - nb_elements + 1;
+			if (selected < firstElement)
+				firstElement = selected;
+
+			s.box(1, top + (selected - firstElement) * lineHeight,
+					gmenu2x.width() - 11, lineHeight,
+					gmenu2x.skinConfColors[COLOR_SELECTION_BG]);
+
+			s.setClipRect(0, top, gmenu2x.width() - 9, height);
+			for (unsigned int i = firstElement;
+					i < results.size() && i < firstElement + nb_elements; i++) {
+				const SearchIndex::Document &doc = results[i];
+				const int iY = top + (i - firstElement) * lineHeight
+						+ lineHeight / 2;
+				const int width = gmenu2x.font->write(s, doc.title, 4, iY,
+						Font::HAlignLeft, Font::VAlignMiddle);
+				if (!doc.text.empty()) {
+					gmenu2x.font->write(s,
+							doc.kind == SearchIndex::Kind::kFile
+								? doc.text : "- " + doc.text,
+							4 + width + 8, iY,
+							Font::HAlignLeft, Font::VAlignMiddle);
+				}
+			}
+			s.clearClipRect();
+		}
+
+		gmenu2x.drawScrollBar(nb_elements, results.size(), firstElement);
+
+		if (service.is_updating() || !complete) {
+			gmenu2x.font->write(s, searching,
+					gmenu2x.width() - 5, gmenu2x.height() - 10,
+					Font::HAlignRight, Font::VAlignMiddle);
+		}
+		s.flip();
+
+		switch (gmenu2x.input.waitForPressedButton()) {
+			case InputManager::SETTINGS:
+			case InputManager::MENU:
+				close = true;
+				return false;
+
+			case InputManager::CANCEL:
+				return false;
+
+			case InputManager::UP:
+				if (selected == 0) selected = max<int>(results.size(), 1) - 1;
+				else selected -= 1;
+				break;
+
+			case InputManager::ALTLEFT:
+				if ((int)(selected - nb_elements + 1) < 0)
+					selected = 0;
+				else
+					selected -= nb_elements - 1;
+				break;
+
+			case InputManager::DOWN:
+				if (selected + 1 >= results.size()) selected = 0;
+				else selected += 1;
+				break;
+
+			case InputManager::ALTRIGHT:
+				if (selected + nb_elements - 1 >= results.size())
+					selected = max<int>(results.size(), 1) - 1;
+				else
+					selected += nb_elements - 1;
+				break;
+
+			case InputManager::ACCEPT:
+				if (selected < results.size()) {
+					result = results[selected];
+					return true;
+				}
+				break;
+
+			case InputManager::REPAINT:
+				stale = true;
+				break;
+
+			default:
+				break;
+		}
+	}
+}
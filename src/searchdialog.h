@@ -0,0 +1,42 @@
+// Various authors.
+// License: GPL version 2 or later.
+
+#ifndef SEARCHDIALOG_H
+#define SEARCHDIALOG_H
+
+#include "dialog.h"
+#include "search_index.h"
+
+#include <string>
+
+class SearchService;
+
+/**
+ * Asks for a search query and lists the matching links and files.
+ */
+class SearchDialog : protected Dialog {
+public:
+	SearchDialog(GMenu2X& gmenu2x, SearchService& service);
+
+	/**
+	 * Returns true if a result was chosen, false if the dialog was closed.
+	 */
+	bool exec();
+
+	const SearchIndex::Document &getResult() { return result; }
+
+private:
+	/**
+	 * Shows the results for the current query.
+	 * Returns true if one was chosen, false to edit the query or close
+	 * the dialog, depending on 'close'.
+	 */
+	bool showResults();
+
+	SearchService& service;
+	std::string query;
+	SearchIndex::Document result;
+	bool close;
+};
+
+#endif // SEARCHDIALOG_H
@@ -20,12 +20,15 @@
 
 #include "selector.h"
 
+#include "collation.h"
 #include "compat-algorithm.h"
 #include "debug.h"
 #include "filelister.h"
 #include "gmenu2x.h"
+#include "jump_bar.h"
 #include "linkapp.h"
 #include "menu.h"
+#include "rom_metadata.h"
 #include "surface.h"
 #include "utilities.h"
 
@@ -35,6 +38,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <cstdio>
 #include <fstream>
 
 using namespace std;
@@ -42,6 +46,9 @@ using namespace std;
 Selector::Selector(GMenu2X& gmenu2x, LinkApp& link, const string &selectorDir)
 	: Dialog(gmenu2x)
 	, link(link)
+	, previews(gmenu2x.width(), gmenu2x.height())
+	, orderedSize(0)
+	, orderedComplete(false)
 {
 	dir = selectorDir.empty() ? link.getSelectorDir() : selectorDir;
 	if (dir[dir.length()-1]!='/') dir += "/";
@@ -61,19 +68,21 @@ int Selector::exec(int startSelection) {
 	OffscreenSurface bg(*gmenu2x.bg);
 	drawTitleIcon(bg, link.getIconPath(), true);
 	writeTitle(bg, link.getTitle());
-	writeSubTitle(bg, link.getDescription());
 
 	int x = 5;
 	if (fl.size() != 0) {
-		x = gmenu2x.drawButton(bg, "accept", gmenu2x.tr["Select"], x);
+		x = gmenu2x.drawButton(bg, "accept", gmenu2x.tr.get("Select"), x);
 	}
 	if (showDirectories) {
 		x = gmenu2x.drawButton(bg, "left", "", x);
-		x = gmenu2x.drawButton(bg, "cancel", gmenu2x.tr["Up one folder"], x);
+		x = gmenu2x.drawButton(bg, "cancel", gmenu2x.tr.get("Up one folder"), x);
 	} else {
 		x = gmenu2x.drawButton(bg, "cancel", "", x);
 	}
-	x = gmenu2x.drawButton(bg, "start", gmenu2x.tr["Exit"], x);
+	if (fl.size() != 0 && !hasDisplayNames()) {
+		x = gmenu2x.drawButton(bg, "right", gmenu2x.tr.get("Jump"), x);
+	}
+	x = gmenu2x.drawButton(bg, "start", gmenu2x.tr.get("Exit"), x);
 	(void)x;
 
 	unsigned int top, height;
@@ -93,17 +102,52 @@ int Selector::exec(int startSelection) {
 
 	bg.convertToDisplayFormat();
 
+	// Resolve the labels that are drawn every frame once.
+	const string noItems = "(" + string(gmenu2x.tr.get("no items")) + ")";
+	const Translator::Id reading = gmenu2x.tr.id("Reading... $1");
+	string status;
+
 	unsigned int firstElement = 0;
 	unsigned int selected = compat::clamp(startSelection, 0, (int)fl.size() - 1);
+	int direction = 1;
+	JumpBar jumpBar(gmenu2x);
 
 	bool close = false, result = true;
 	while (!close) {
 		OutputSurface& s = *gmenu2x.s;
 
+		if (!fl.isComplete()) {
+			// Keep the same entry selected while entries are added.
+			const bool hasSelection = selected < fl.size();
+			const unsigned int entry = hasSelection ? entryAt(fl, selected) : 0;
+			const string name = hasSelection ? string(fl[entry]) : string();
+			const bool isDir = hasSelection && fl.isDirectory(entry);
+			if (fl.update() && hasSelection) {
+				sortByName(fl);
+				int index = fl.indexOf(name, isDir);
+				if (index >= 0) selected = rowOf(fl, index);
+			}
+		}
+		if (orderedDir != dir || orderedSize != fl.size()
+				|| orderedComplete != fl.isComplete()) {
+			sortByName(fl);
+		}
+
 		bg.blit(s, 0, 0);
 
+		// Show the description of the selected file, if it has one.
+		RomMetadata::Info info;
+		if (metadata && selected < fl.size()
+				&& fl.isFile(entryAt(fl, selected))
+				&& metadata->Find(fl[entryAt(fl, selected)], &info)
+				&& !info.description.empty()) {
+			writeSubTitle(s, string(info.description));
+		} else {
+			writeSubTitle(s, link.getDescription());
+		}
+
 		if (fl.size() == 0) {
-			gmenu2x.font->write(s, "(" + gmenu2x.tr["no items"] + ")",
+			gmenu2x.font->write(s, noItems,
 					4, top + lineHeight / 2,
 					Font::HAlignLeft, Font::VAlignMiddle);
 		} else {
@@ -113,9 +157,10 @@ int Selector::exec(int startSelection) {
 				firstElement = selected;
 
 			//Screenshot
-			if (fl.isFile(selected)) {
-				string path = screendir + trimExtension(fl[selected]) + ".png";
-				auto screenshot = OffscreenSurface::loadImage(path, false);
+			requestPreviews(fl, selected, direction);
+			if (fl.isFile(entryAt(fl, selected))) {
+				auto screenshot = previews.Find(
+						previewName(fl, entryAt(fl, selected)));
 				if (screenshot) {
 					screenshot->blitRight(s, gmenu2x.width(), 0, gmenu2x.width(), gmenu2x.height(), 128u);
 				}
@@ -127,22 +172,24 @@ int Selector::exec(int startSelection) {
 				s.box(1, iY, gmenu2x.width()-11, lineHeight, gmenu2x.skinConfColors[COLOR_SELECTION_BG]);
 
 			//Files & Dirs
+			const bool trimExt = gmenu2x.confInt["trimExt"];
 			s.setClipRect(0, top, gmenu2x.width()-9, height);
 			for (unsigned int i = firstElement;
 					i < fl.size() && i < firstElement + nb_elements; i++) {
 				iY = top + (i - firstElement) * lineHeight;
 				x = 4;
-				if (fl.isDirectory(i)) {
+				const unsigned int entry = entryAt(fl, i);
+				if (fl.isDirectory(entry)) {
 					if (folderIcon) {
 						folderIcon->blit(s,
 								x, iY + (lineHeight - folderIcon->height()) / 2);
 						x += folderIcon->width() + 2;
 					}
-					gmenu2x.font->write(s, fl[i],
+					gmenu2x.font->write(s, fl[entry],
 							x, iY + lineHeight / 2,
 							Font::HAlignLeft, Font::VAlignMiddle);
 				} else {
-					gmenu2x.font->write(s, (gmenu2x.confInt["trimExt"] ? trimExtension(fl[i]) : fl[i]),
+					gmenu2x.font->write(s, displayName(fl, entry, trimExt),
 							x, iY + lineHeight / 2,
 							Font::HAlignLeft, Font::VAlignMiddle);
 				}
@@ -151,20 +198,39 @@ int Selector::exec(int startSelection) {
 		}
 
 		gmenu2x.drawScrollBar(nb_elements, fl.size(), firstElement);
+		jumpBar.Paint(s);
+
+		if (!fl.isComplete()) {
+			char count[16];
+			snprintf(count, sizeof(count), "%zu", fl.scannedCount());
+			gmenu2x.font->write(s,
+					gmenu2x.tr.format(status, reading, count, NULL),
+					gmenu2x.width() - 5, gmenu2x.height() - 10,
+					Font::HAlignRight, Font::VAlignMiddle);
+		}
 		s.flip();
 
-		switch (gmenu2x.input.waitForPressedButton()) {
+		InputManager::Button button = gmenu2x.input.waitForPressedButton();
+		if (jumpBar.is_open()) {
+			unsigned int entry = entryAt(fl, selected);
+			jumpBar.HandleButton(button, fl, &entry);
+			selected = rowOf(fl, entry);
+			continue;
+		}
+		switch (button) {
 			case InputManager::SETTINGS:
 				close = true;
 				result = false;
 				break;
 
 			case InputManager::UP:
+				direction = -1;
 				if (selected == 0) selected = fl.size() -1;
 				else selected -= 1;
 				break;
 
 			case InputManager::ALTLEFT:
+				direction = -1;
 				if ((int)(selected - nb_elements + 1) < 0)
 					selected = 0;
 				else
@@ -172,17 +238,27 @@ int Selector::exec(int startSelection) {
 				break;
 
 			case InputManager::DOWN:
+				direction = 1;
 				if (selected+1>=fl.size()) selected = 0;
 				else selected += 1;
 				break;
 
 			case InputManager::ALTRIGHT:
+				direction = 1;
 				if (selected + nb_elements - 1 >= fl.size())
 					selected = fl.size() - 1;
 				else
 					selected += nb_elements - 1;
 				break;
 
+			case InputManager::RIGHT: {
+				if (hasDisplayNames()) break;
+				unsigned int entry = entryAt(fl, selected);
+				jumpBar.Open(fl, &entry);
+				selected = rowOf(fl, entry);
+				break;
+			}
+
 			case InputManager::CANCEL:
 				if (!showDirectories) {
 					close = true;
@@ -199,11 +275,12 @@ int Selector::exec(int startSelection) {
 
 			case InputManager::ACCEPT:
 				if (fl.size() != 0) {
-					if (fl.isFile(selected)) {
-						file = fl[selected];
+					const unsigned int entry = entryAt(fl, selected);
+					if (fl.isFile(entry)) {
+						file = string(fl[entry]);
 						close = true;
 					} else {
-						string subdir = fl[selected];
+						const string subdir(fl[entry]);
 						if (subdir == "..") {
 							selected = goToParentDir(fl);
 						} else {
@@ -225,23 +302,121 @@ int Selector::exec(int startSelection) {
 }
 
 bool Selector::prepare(FileLister& fl) {
-	bool opened = fl.browse(dir);
+	bool opened = fl.browseIncremental(dir);
 
 	screendir = dir;
 	if (!screendir.empty() && screendir[screendir.length() - 1] != '/') {
 		screendir += "/";
 	}
 	screendir += "previews/";
+	previews.SetDirectory(screendir);
+
+	metadata = RomMetadata::Open(dir);
+	orderedDir.clear();
 
 	return opened;
 }
 
+void Selector::sortByName(FileLister& fl) {
+	orderedDir = dir;
+	orderedSize = fl.size();
+	orderedComplete = fl.isComplete();
+	order.clear();
+	rowOfFile.clear();
+	if (!orderedComplete || !hasDisplayNames()) {
+		return;
+	}
+
+	const bool trimExt = gmenu2x.confInt["trimExt"];
+	const unsigned int dirCount = fl.dirCount();
+	const unsigned int fileCount = fl.fileCount();
+	vector<compat::string_view> names(fileCount);
+	vector<string> keys(fileCount);
+	for (unsigned int i = 0; i < fileCount; i++) {
+		names[i] = displayName(fl, dirCount + i, trimExt);
+		keys[i] = CollationKey(names[i]);
+	}
+	order.resize(fileCount);
+	for (unsigned int i = 0; i < fileCount; i++) {
+		order[i] = i;
+	}
+	stable_sort(order.begin(), order.end(),
+			[&names, &keys](unsigned int a, unsigned int b) {
+				const int cmp = keys[a].compare(keys[b]);
+				return cmp != 0 ? cmp < 0 : names[a] < names[b];
+			});
+	rowOfFile.resize(fileCount);
+	for (unsigned int row = 0; row < fileCount; row++) {
+		rowOfFile[order[row]] = row;
+	}
+}
+
+bool Selector::hasDisplayNames() const {
+	return metadata && metadata->size() != 0;
+}
+
+unsigned int Selector::entryAt(FileLister& fl, unsigned int row) {
+	const unsigned int dirCount = fl.dirCount();
+	if (row < dirCount || row - dirCount >= order.size()) {
+		return row;
+	}
+	return dirCount + order[row - dirCount];
+}
+
+unsigned int Selector::rowOf(FileLister& fl, unsigned int entry) {
+	const unsigned int dirCount = fl.dirCount();
+	if (entry < dirCount || entry - dirCount >= rowOfFile.size()) {
+		return entry;
+	}
+	return dirCount + rowOfFile[entry - dirCount];
+}
+
+compat::string_view Selector::displayName(FileLister& fl, unsigned int entry,
+		bool trimExt) {
+	RomMetadata::Info info;
+	if (metadata && metadata->Find(fl[entry], &info) && !info.name.empty()) {
+		return info.name;
+	}
+	return trimExt ? fl.stem(entry) : fl[entry];
+}
+
+string Selector::previewName(FileLister& fl, unsigned int entry) {
+	RomMetadata::Info info;
+	if (metadata && metadata->Find(fl[entry], &info) && !info.preview.empty()) {
+		return string(info.preview);
+	}
+	return string(fl.stem(entry)) + ".png";
+}
+
+void Selector::requestPreviews(FileLister& fl, unsigned int selected, int direction) {
+	// Number of entries to prefetch in and against the scroll direction.
+	static const int PREFETCH_AHEAD = 4, PREFETCH_BEHIND = 1;
+
+	vector<string> names;
+	auto want = [&](int row) {
+		if (row < 0 || row >= (int)fl.size()) return;
+		const unsigned int entry = entryAt(fl, row);
+		if (fl.isFile(entry))
+			names.push_back(previewName(fl, entry));
+	};
+	want(selected);
+	for (int i = 1; i <= PREFETCH_AHEAD; i++)
+		want(selected + i * direction);
+	for (int i = 1; i <= PREFETCH_BEHIND; i++)
+		want(selected - i * direction);
+	previews.Request(names);
+}
+
 int Selector::goToParentDir(FileLister& fl) {
 	string oldDir = dir;
 	dir = parentDir(dir);
 	prepare(fl);
 	string oldName = oldDir.substr(dir.size(), oldDir.size() - dir.size() - 1);
-	auto& subdirs = fl.getDirectories();
-	auto it = find(subdirs.begin(), subdirs.end(), oldName);
-	return it == subdirs.end() ? 0 : it - subdirs.begin();
+	int index = fl.indexOf(oldName, true);
+	if (index < 0 && !fl.isComplete()) {
+		// Don't lose our place if the parent is a huge directory.
+		fl.finish();
+		index = fl.indexOf(oldName, true);
+	}
+	return max(index, 0);
 }
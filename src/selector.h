@@ -21,22 +21,65 @@
 #ifndef SELECTOR_H
 #define SELECTOR_H
 
+#include "compat-string_view.h"
 #include "dialog.h"
+#include "preview_loader.h"
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 class LinkApp;
 class FileLister;
+class RomMetadata;
 
 class Selector : protected Dialog {
 private:
 	LinkApp& link;
 	std::string file, dir, screendir;
+	PreviewLoader previews;
+	std::shared_ptr<const RomMetadata> metadata;
+
+	/**
+	 * The files in the order they are shown, as indices into the files of
+	 * the lister, and the row of each file. Both are empty if the files are
+	 * shown in the order of the lister.
+	 */
+	std::vector<unsigned int> order, rowOfFile;
+	std::string orderedDir;
+	size_t orderedSize;
+	bool orderedComplete;
 
 	bool prepare(FileLister& fl);
 
+	/**
+	 * Sorts the files by the names they are shown with, if the metadata of
+	 * the directory gives any of them another name. Only done once the
+	 * directory has been read completely, so that a long scan is not sorted
+	 * again after every batch.
+	 */
+	void sortByName(FileLister& fl);
+	/**
+	 * Whether the metadata of the directory gives files other names. The
+	 * jump bar is not offered then, since it spells the file names.
+	 */
+	bool hasDisplayNames() const;
+	/** Returns the index in the lister of the entry shown on the given row. */
+	unsigned int entryAt(FileLister& fl, unsigned int row);
+	/** Returns the row the given entry of the lister is shown on. */
+	unsigned int rowOf(FileLister& fl, unsigned int entry);
+	compat::string_view displayName(FileLister& fl, unsigned int entry,
+			bool trimExt);
+	std::string previewName(FileLister& fl, unsigned int entry);
+
+	/**
+	 * Asks for the preview of the selected entry to be decoded, followed by
+	 * those of the entries that are likely to be selected next.
+	 * @param direction 1 when scrolling down, -1 when scrolling up.
+	 */
+	void requestPreviews(FileLister& fl, unsigned int selected, int direction);
+
 	/**
 	 * Changes 'dir' to its parent directory.
 	 * Returns the index of the old dir in the parent, or 0 if unknown.
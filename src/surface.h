@@ -128,6 +128,7 @@ public:
 
 private:
 	friend class FontStack;
+	friend class ThumbnailCache;
 	OffscreenSurface(SDL_Surface *raw) : Surface(raw) {}
 };
 
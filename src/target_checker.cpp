@@ -0,0 +1,72 @@
+#include "target_checker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "utilities.h"
+
+namespace {
+
+// Removes the targets that exist. Checking is mostly waiting for the
+// storage, so several are checked at once.
+void RemoveExisting(std::vector<TargetChecker::Target> *targets) {
+	std::vector<char> exists(targets->size());
+	std::atomic<std::size_t> next(0);
+	auto check = [&]() {
+		for (std::size_t i; (i = next++) < targets->size();)
+			exists[i] = fileExists((*targets)[i].path);
+	};
+	std::size_t num_threads = std::min<std::size_t>(
+	    std::min(std::thread::hardware_concurrency(), 4u), targets->size());
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < num_threads; i++) threads.emplace_back(check);
+	check();
+	for (std::thread &thread : threads) thread.join();
+
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < targets->size(); i++) {
+		if (!exists[i]) (*targets)[kept++] = std::move((*targets)[i]);
+	}
+	targets->resize(kept);
+}
+
+}  // namespace
+
+TargetChecker::TargetChecker() : thread_(&TargetChecker::Run, this) {}
+
+TargetChecker::~TargetChecker() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	cond_.notify_all();
+	thread_.join();
+}
+
+void TargetChecker::Check(Batch batch) {
+	if (batch.targets.empty()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queue_.push_back(std::move(batch));
+	}
+	cond_.notify_one();
+}
+
+void TargetChecker::Run() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;) {
+		cond_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+		if (quit_) return;
+
+		Batch batch = std::move(queue_.front());
+		queue_.pop_front();
+		lock.unlock();
+		RemoveExisting(&batch.targets);
+		if (!batch.targets.empty()) {
+			missing_.Push(std::move(batch));
+			request_repaint();
+		}
+		lock.lock();
+	}
+}
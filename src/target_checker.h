@@ -0,0 +1,56 @@
+#ifndef _TARGET_CHECKER_H_
+#define _TARGET_CHECKER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mpsc_queue.h"
+
+// Checks in a background thread whether the targets of links exist, so that
+// showing a section never waits for a stat per link on a slow card.
+class TargetChecker {
+ public:
+	struct Target {
+		std::string file;  // the link file, which identifies the link
+		std::string path;  // the path that must exist
+	};
+
+	// The link targets of one section, to check or found to be missing.
+	struct Batch {
+		std::string section;
+		std::vector<Target> targets;
+	};
+
+	TargetChecker();
+
+	TargetChecker(const TargetChecker &) = delete;
+	TargetChecker &operator=(const TargetChecker &) = delete;
+
+	// Waits for the batch being checked, if any.
+	~TargetChecker();
+
+	// Queues the given targets to be checked.
+	void Check(Batch batch);
+
+	// Returns the checked batches that have missing targets, with only
+	// those. A repaint is requested whenever there are new ones.
+	std::vector<Batch> TakeMissing() { return missing_.TakeAll(); }
+
+ private:
+	void Run();
+
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::deque<Batch> queue_;
+	bool quit_ = false;
+
+	MpscQueue<Batch> missing_;
+
+	std::thread thread_;
+};
+
+#endif  // _TARGET_CHECKER_H_
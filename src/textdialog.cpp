@@ -73,9 +73,9 @@ void TextDialog::exec() {
 
 	int x = 5;
 	x = gmenu2x.drawButton(bg, "up", "", x);
-	x = gmenu2x.drawButton(bg, "down", gmenu2x.tr["Scroll"], x);
+	x = gmenu2x.drawButton(bg, "down", gmenu2x.tr.get("Scroll"), x);
 	x = gmenu2x.drawButton(bg, "cancel", "", x);
-	x = gmenu2x.drawButton(bg, "start", gmenu2x.tr["Exit"], x);
+	x = gmenu2x.drawButton(bg, "start", gmenu2x.tr.get("Exit"), x);
 	(void)x;
 
 	bg.convertToDisplayFormat();
@@ -25,7 +25,7 @@
 #include "utilities.h"
 
 #include <algorithm>
-#include <sstream>
+#include <cstdio>
 
 using namespace std;
 
@@ -81,19 +81,16 @@ void TextManualDialog::exec() {
 
 	int x = 5;
 	x = gmenu2x.drawButton(bg, "up", "", x);
-	x = gmenu2x.drawButton(bg, "down", gmenu2x.tr["Scroll"], x);
+	x = gmenu2x.drawButton(bg, "down", gmenu2x.tr.get("Scroll"), x);
 	x = gmenu2x.drawButton(bg, "left", "", x);
-	x = gmenu2x.drawButton(bg, "right", gmenu2x.tr["Change page"], x);
+	x = gmenu2x.drawButton(bg, "right", gmenu2x.tr.get("Change page"), x);
 	x = gmenu2x.drawButton(bg, "cancel", "", x);
-	x = gmenu2x.drawButton(bg, "start", gmenu2x.tr["Exit"], x);
+	x = gmenu2x.drawButton(bg, "start", gmenu2x.tr.get("Exit"), x);
 	(void)x;
 
 	bg.convertToDisplayFormat();
 
-	stringstream ss;
-	ss << pages.size();
-	string spagecount;
-	ss >> spagecount;
+	const compat::string_view pageLabel = gmenu2x.tr.get("Page");
 	string pageStatus;
 
 	const int fontHeight = gmenu2x.font->getLineSpacing();
@@ -112,10 +109,11 @@ void TextManualDialog::exec() {
 		writeSubTitle(s, pages[page].title);
 		drawText(pages[page].text, contentY, firstRow, rowsPerPage);
 
-		ss.clear();
-		ss << page+1;
-		ss >> pageStatus;
-		pageStatus = gmenu2x.tr["Page"]+": "+pageStatus+"/"+spagecount;
+		char pageNumbers[32];
+		snprintf(pageNumbers, sizeof(pageNumbers), ": %u/%zu",
+				page + 1, pages.size());
+		pageStatus.assign(pageLabel.data(), pageLabel.size());
+		pageStatus += pageNumbers;
 		gmenu2x.font->write(s, pageStatus, 310, 230, Font::HAlignRight, Font::VAlignMiddle);
 
 		s.flip();
@@ -0,0 +1,307 @@
+#include "thumbnail_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <system_error>
+#include <vector>
+
+#include <SDL.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compat-filesystem.h"
+#include "debug.h"
+#include "gmenu2x.h"
+#include "imageio.h"
+#include "surface.h"
+#include "utilities.h"
+
+namespace {
+
+// About fifty full-screen thumbnails at 320x240, more of smaller previews.
+constexpr std::uint64_t kMaxCacheSize = 16 << 20;
+
+// Evicting a bit more than needed avoids evicting on every write.
+constexpr std::uint64_t kEvictedCacheSize = kMaxCacheSize * 3 / 4;
+
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kFlagAlpha = 1 << 0;
+
+// Eviction only needs a rough order of use, so a thumbnail that is read
+// again is touched at most this often, rather than on every read.
+constexpr time_t kTouchInterval = 60 * 60;
+
+// Sanity limit for the dimensions in a thumbnail file.
+constexpr std::uint32_t kMaxDimension = 4096;
+
+struct Header {
+	char magic[4];  // "G2XI"
+	std::uint32_t version;
+	// Of the image the thumbnail was made from.
+	std::int64_t mtime;
+	std::uint64_t size;
+	std::uint32_t width, height;
+	std::uint32_t flags;
+	std::uint32_t path_length;
+	// Followed by the path of the image, then by the ARGB pixels.
+};
+
+std::string FileName(const std::string &path, int max_width, int max_height,
+                     bool alpha) {
+	// FNV-1a; collisions are caught by the path stored in the file.
+	std::uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const std::string &data) {
+		for (unsigned char c : data) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+	};
+	add(path);
+	add('\n' + std::to_string(max_width) + 'x' + std::to_string(max_height) +
+	    (alpha ? "a" : ""));
+
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx",
+	         static_cast<unsigned long long>(hash));
+	return name;
+}
+
+SDL_Surface *CreateSurface(int width, int height, bool alpha) {
+	return SDL_CreateRGBSurface(SDL_SWSURFACE | SDL_SRCALPHA, width, height,
+	                            32, 0x00FF0000, 0x0000FF00, 0x000000FF,
+	                            alpha ? 0xFF000000 : 0x00000000);
+}
+
+std::uint32_t *Row(SDL_Surface *surface, int y) {
+	return reinterpret_cast<std::uint32_t *>(
+	    static_cast<std::uint8_t *>(surface->pixels) + y * surface->pitch);
+}
+
+// Scales an ARGB surface down by averaging the source pixels that cover each
+// destination pixel.
+SDL_Surface *Downscale(SDL_Surface *src, int width, int height, bool alpha) {
+	SDL_Surface *dst = CreateSurface(width, height, alpha);
+	if (!dst) return nullptr;
+
+	for (int y = 0; y < height; ++y) {
+		const int y0 = y * src->h / height;
+		const int y1 = std::max((y + 1) * src->h / height, y0 + 1);
+		std::uint32_t *out = Row(dst, y);
+		for (int x = 0; x < width; ++x) {
+			const int x0 = x * src->w / width;
+			const int x1 = std::max((x + 1) * src->w / width, x0 + 1);
+			std::uint64_t sum[4] = {};
+			for (int sy = y0; sy < y1; ++sy) {
+				const std::uint32_t *in = Row(src, sy);
+				for (int sx = x0; sx < x1; ++sx) {
+					const std::uint32_t p = in[sx];
+					sum[0] += p & 0xFF;
+					sum[1] += (p >> 8) & 0xFF;
+					sum[2] += (p >> 16) & 0xFF;
+					sum[3] += p >> 24;
+				}
+			}
+			const std::uint64_t n = (x1 - x0) * (y1 - y0);
+			out[x] = static_cast<std::uint32_t>(
+			    sum[0] / n | (sum[1] / n) << 8 | (sum[2] / n) << 16 |
+			    (sum[3] / n) << 24);
+		}
+	}
+	return dst;
+}
+
+bool ReadFully(int fd, void *buf, std::size_t size) {
+	auto *bytes = static_cast<char *>(buf);
+	while (size != 0) {
+		const ssize_t n = read(fd, bytes, size);
+		if (n <= 0) return false;
+		bytes += n;
+		size -= n;
+	}
+	return true;
+}
+
+// Returns nullptr if the file does not exist or is not a thumbnail of the
+// current version of the image. Otherwise sets `last_used` to the
+// modification time of the file.
+SDL_Surface *ReadThumbnail(const std::string &file, const std::string &path,
+                           const struct stat &st, time_t *last_used) {
+	const int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return nullptr;
+
+	SDL_Surface *surface = nullptr;
+	struct stat file_st;
+	Header header;
+	std::string stored_path;
+	if (fstat(fd, &file_st) == 0 &&
+	    ReadFully(fd, &header, sizeof(header)) &&
+	    memcmp(header.magic, "G2XI", 4) == 0 && header.version == kVersion &&
+	    header.mtime == st.st_mtime &&
+	    header.size == static_cast<std::uint64_t>(st.st_size) &&
+	    header.width <= kMaxDimension && header.height <= kMaxDimension &&
+	    header.path_length == path.size()) {
+		stored_path.resize(header.path_length);
+		if (ReadFully(fd, &stored_path[0], stored_path.size()) &&
+		    stored_path == path) {
+			surface = CreateSurface(header.width, header.height,
+			                        header.flags & kFlagAlpha);
+		}
+	}
+	for (int y = 0; surface && y < surface->h; ++y) {
+		if (!ReadFully(fd, Row(surface, y), surface->w * 4)) {
+			SDL_FreeSurface(surface);
+			surface = nullptr;
+		}
+	}
+	close(fd);
+	if (surface) *last_used = file_st.st_mtime;
+	return surface;
+}
+
+std::string Serialize(const std::string &path, const struct stat &st,
+                      SDL_Surface *surface, bool alpha) {
+	Header header;
+	memcpy(header.magic, "G2XI", 4);
+	header.version = kVersion;
+	header.mtime = st.st_mtime;
+	header.size = st.st_size;
+	header.width = surface->w;
+	header.height = surface->h;
+	header.flags = alpha ? kFlagAlpha : 0;
+	header.path_length = path.size();
+
+	std::string data;
+	data.reserve(sizeof(header) + path.size() + surface->w * surface->h * 4);
+	data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+	data += path;
+	for (int y = 0; y < surface->h; ++y) {
+		data.append(reinterpret_cast<const char *>(Row(surface, y)),
+		            surface->w * 4);
+	}
+	return data;
+}
+
+struct CachedFile {
+	std::string path;
+	std::uint64_t size;
+	struct timespec mtime;
+};
+
+std::vector<CachedFile> ListCachedFiles(const std::string &dir) {
+	std::vector<CachedFile> files;
+	DIR *dirp = opendir(dir.c_str());
+	if (!dirp) return files;
+	while (struct dirent *dent = readdir(dirp)) {
+		// Skip "." and "..", and temporary files of interrupted writes.
+		const std::size_t len = strlen(dent->d_name);
+		if (dent->d_name[0] == '.' || dent->d_name[len - 1] == '~') continue;
+		const std::string path = dir + "/" + dent->d_name;
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+		files.push_back(CachedFile{path, static_cast<std::uint64_t>(st.st_size),
+		                           st.st_mtim});
+	}
+	closedir(dirp);
+	return files;
+}
+
+}  // namespace
+
+ThumbnailCache &ThumbnailCache::instance() {
+	static ThumbnailCache cache;
+	return cache;
+}
+
+ThumbnailCache::ThumbnailCache()
+    : dir_(GMenu2X::getHome() + "/cache/thumbnails") {}
+
+std::unique_ptr<OffscreenSurface> ThumbnailCache::Get(
+    const std::string &path, int max_width, int max_height, bool alpha) {
+	static_assert(sizeof(Header) == 40, "unexpected padding in Header");
+
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return nullptr;
+
+	const std::string file =
+	    dir_ + "/" + FileName(path, max_width, max_height, alpha);
+	time_t last_used;
+	if (SDL_Surface *cached = ReadThumbnail(file, path, st, &last_used)) {
+		// The modification time tells eviction when it was last used.
+		if (time(nullptr) - last_used > kTouchInterval)
+			utimensat(AT_FDCWD, file.c_str(), nullptr, 0);
+		return std::unique_ptr<OffscreenSurface>(new OffscreenSurface(cached));
+	}
+
+	SDL_Surface *image = loadPNG(path, alpha);
+	if (!image) return nullptr;
+
+	int width = image->w, height = image->h;
+	if (width > max_width) {
+		height = height * max_width / width;
+		width = max_width;
+	}
+	if (height > max_height) {
+		width = width * max_height / height;
+		height = max_height;
+	}
+	width = std::max(width, 1);
+	height = std::max(height, 1);
+	if (width != image->w || height != image->h) {
+		SDL_Surface *scaled = Downscale(image, width, height, alpha);
+		SDL_FreeSurface(image);
+		if (!scaled) return nullptr;
+		image = scaled;
+	}
+
+	Store(file, Serialize(path, st, image, alpha));
+	return std::unique_ptr<OffscreenSurface>(new OffscreenSurface(image));
+}
+
+void ThumbnailCache::Store(const std::string &file, const std::string &data) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!scanned_) {
+		std::error_code ec;
+		compat::filesystem::create_directories(dir_, ec);
+		for (const CachedFile &cached : ListCachedFiles(dir_))
+			total_size_ += cached.size;
+		scanned_ = true;
+	}
+
+	// A stale thumbnail of the same image is replaced.
+	struct stat old;
+	const std::uint64_t replaced =
+	    stat(file.c_str(), &old) == 0 ? old.st_size : 0;
+
+	// Not synced: a thumbnail that is lost or cut short by a crash fails
+	// to read back, and is made again.
+	if (!writeStringToFile(file, data, false)) {
+		WARNING("Unable to write thumbnail '%s'\n", file.c_str());
+		return;
+	}
+	total_size_ -= std::min(total_size_, replaced);
+	total_size_ += data.size();
+	if (total_size_ > kMaxCacheSize) Evict();
+}
+
+void ThumbnailCache::Evict() {
+	std::vector<CachedFile> files = ListCachedFiles(dir_);
+	std::sort(files.begin(), files.end(),
+	          [](const CachedFile &a, const CachedFile &b) {
+		          return a.mtime.tv_sec != b.mtime.tv_sec
+		                     ? a.mtime.tv_sec < b.mtime.tv_sec
+		                     : a.mtime.tv_nsec < b.mtime.tv_nsec;
+	          });
+
+	total_size_ = 0;
+	for (const CachedFile &cached : files) total_size_ += cached.size;
+	for (const CachedFile &cached : files) {
+		if (total_size_ <= kEvictedCacheSize) break;
+		if (unlink(cached.path.c_str()) == 0) total_size_ -= cached.size;
+	}
+	DEBUG("Thumbnail cache evicted down to %llu bytes\n",
+	      static_cast<unsigned long long>(total_size_));
+}
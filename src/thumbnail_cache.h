@@ -0,0 +1,52 @@
+#ifndef _THUMBNAIL_CACHE_H_
+#define _THUMBNAIL_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class OffscreenSurface;
+
+// Downscaled copies of images, kept under ~/.gmenu2x/cache/thumbnails so
+// that browsing a folder of images decodes each PNG only once.
+//
+// A thumbnail is stored as raw 32-bit pixels, which are read back much
+// faster than a PNG is decoded. It is keyed by the path of the image and the
+// requested bounds, and regenerated when the modification time or size of
+// the image changes. When the cache grows too large, the thumbnails that were
+// used least recently are removed. Use is tracked to within an hour, so that
+// reading a thumbnail rarely writes to the card.
+//
+// May be used from any thread.
+class ThumbnailCache {
+ public:
+	static ThumbnailCache &instance();
+
+	ThumbnailCache(const ThumbnailCache &) = delete;
+	ThumbnailCache &operator=(const ThumbnailCache &) = delete;
+
+	// Returns the image at `path` scaled down to fit in the given bounds,
+	// keeping its aspect ratio. Smaller images are not scaled up.
+	// Returns nullptr if the image cannot be loaded.
+	//
+	// The surface is not in display format, because the conversion must be
+	// done by the main thread.
+	std::unique_ptr<OffscreenSurface> Get(const std::string &path,
+	                                      int max_width, int max_height,
+	                                      bool alpha = false);
+
+ private:
+	ThumbnailCache();
+
+	void Store(const std::string &file, const std::string &data);
+	void Evict();
+
+	const std::string dir_;
+
+	std::mutex mutex_;
+	std::uint64_t total_size_ = 0;  // of the files in dir_, once scanned_
+	bool scanned_ = false;
+};
+
+#endif  // _THUMBNAIL_CACHE_H_
@@ -20,82 +20,449 @@
 
 #include "translator.h"
 
+#include "compat-filesystem.h"
 #include "debug.h"
 #include "gmenu2x.h"
 #include "utilities.h"
 
+#include <cstring>
 #include <fstream>
-#include <iostream>
-#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
 #include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
-Translator::Translator(const string &lang) {
+/*
+ * Layout of a compiled catalog, in native byte order:
+ *
+ *   Header
+ *   uint32_t buckets[numBuckets]    entry index + 1, or 0 if empty
+ *   Entry    entries[numEntries]
+ *   Segment  segments[numSegments]  preparsed translations
+ *   char     strings[stringsSize]
+ */
+struct Translator::Header {
+	char magic[4];
+	uint32_t version;
+	// Identifies the text catalog this was compiled from.
+	int64_t sourceMtime;
+	uint64_t sourceSize;
+	uint32_t numBuckets;
+	uint32_t numEntries;
+	uint32_t numSegments;
+	uint32_t stringsSize;
+};
+
+struct Translator::Entry {
+	uint32_t hash;
+	uint32_t keyOffset, keyLength;
+	uint32_t valueOffset, valueLength;
+	uint32_t firstSegment, numSegments;
+};
+
+/*
+ * A piece of a translation: either literal text or, if param is not 0,
+ * a "$<param>" placeholder.
+ */
+struct Translator::Segment {
+	uint32_t param;
+	uint32_t offset, length;
+};
+
+static const char CATALOG_MAGIC[4] = { 'G', '2', 'X', 'T' };
+static const uint32_t CATALOG_VERSION = 1;
+
+static uint32_t hashTerm(compat::string_view term) {
+	// FNV-1a, which unlike std::hash is stable across builds.
+	uint32_t hash = 2166136261u;
+	for (char c : term) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * Splits a translation into literal text and "$N" placeholders.
+ * Offsets are relative to the start of the text plus `base`.
+ */
+template <typename Segment>
+static void parseTemplate(compat::string_view text, uint32_t base,
+		vector<Segment> &segments) {
+	size_t start = 0;
+	size_t pos = 0;
+	while ((pos = text.find('$', pos)) != compat::string_view::npos) {
+		size_t end = pos + 1;
+		uint32_t param = 0;
+		while (end < text.size() && text[end] >= '0' && text[end] <= '9'
+				&& param < 1000) {
+			param = param * 10 + (text[end] - '0');
+			++end;
+		}
+		if (param == 0) {
+			pos = end;
+			continue;
+		}
+		if (pos > start) {
+			segments.push_back(Segment { 0, static_cast<uint32_t>(base + start),
+					static_cast<uint32_t>(pos - start) });
+		}
+		segments.push_back(Segment { param, static_cast<uint32_t>(base + pos),
+				static_cast<uint32_t>(end - pos) });
+		start = pos = end;
+	}
+	if (start < text.size()) {
+		segments.push_back(Segment { 0, static_cast<uint32_t>(base + start),
+				static_cast<uint32_t>(text.size() - start) });
+	}
+}
+
+template <typename T>
+static void appendRaw(string &out, const vector<T> &items) {
+	out.append(reinterpret_cast<const char *>(items.data()),
+			items.size() * sizeof(T));
+}
+
+Translator::Translator(const string &lang)
+	: data(nullptr)
+	, size(0)
+	, mapping(nullptr)
+	, header(nullptr)
+{
 	_lang = "";
 	if (!lang.empty())
 		setLang(lang);
 }
 
-Translator::~Translator() {}
+Translator::~Translator() {
+	unload();
+}
 
-bool Translator::exists(const string &term) {
-	return translations.find(term) != translations.end();
+void Translator::unload() {
+	if (mapping) {
+		munmap(mapping, size);
+		mapping = nullptr;
+	}
+	buffer.clear();
+	buffer.shrink_to_fit();
+	data = nullptr;
+	size = 0;
+	header = nullptr;
+	warned.clear();
+	untranslated.clear();
+	untranslatedIds.clear();
 }
 
-void Translator::setLang(const string &lang) {
-	translations.clear();
+bool Translator::exists(const string &term) {
+	return lookup(term) != NO_ID;
+}
 
-	string line;
-	ifstream infile ((GMenu2X::getHome() + "/translations/" + lang).c_str(), ios_base::in);
+string Translator::compile(const string &path,
+		int64_t sourceMtime, uint64_t sourceSize) {
+	ifstream infile(path.c_str(), ios_base::in);
 	if (!infile.is_open())
-	  infile.open((string(GMENU2X_SYSTEM_DIR "/translations/") + lang).c_str(), ios_base::in);
+		return "";
 
-	if (infile.is_open()) {
-		while (getline(infile, line, '\n')) {
-			line = trim(line);
-			if (line.empty()) continue;
-			if (line[0]=='#') continue;
+	// Later definitions of a term override earlier ones.
+	vector<pair<string, string>> terms;
+	unordered_map<string, size_t> index;
+	string line;
+	while (getline(infile, line, '\n')) {
+		line = trim(line);
+		if (line.empty()) continue;
+		if (line[0]=='#') continue;
 
-			string::size_type position = line.find("=");
-			translations[ trim(line.substr(0,position)) ] = trim(line.substr(position+1));
+		string::size_type position = line.find("=");
+		string key = trim(line.substr(0,position));
+		string value = trim(line.substr(position+1));
+		auto it = index.find(key);
+		if (it != index.end()) {
+			terms[it->second].second = move(value);
+		} else {
+			index[key] = terms.size();
+			terms.emplace_back(move(key), move(value));
 		}
-		infile.close();
-		_lang = lang;
 	}
+	infile.close();
+
+	uint32_t numBuckets = 16;
+	while (numBuckets < terms.size() * 2)
+		numBuckets *= 2;
+
+	vector<uint32_t> buckets(numBuckets, 0);
+	vector<Entry> entries;
+	vector<Segment> segments;
+	string strings;
+	for (const auto &term : terms) {
+		Entry entry;
+		entry.hash = hashTerm(term.first);
+		entry.keyOffset = strings.size();
+		entry.keyLength = term.first.size();
+		strings += term.first;
+		entry.valueOffset = strings.size();
+		entry.valueLength = term.second.size();
+		strings += term.second;
+		entry.firstSegment = segments.size();
+		parseTemplate(term.second, entry.valueOffset, segments);
+		entry.numSegments = segments.size() - entry.firstSegment;
+
+		uint32_t bucket = entry.hash & (numBuckets - 1);
+		while (buckets[bucket] != 0)
+			bucket = (bucket + 1) & (numBuckets - 1);
+		entries.push_back(entry);
+		buckets[bucket] = entries.size();
+	}
+
+	Header header;
+	memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+	header.version = CATALOG_VERSION;
+	header.sourceMtime = sourceMtime;
+	header.sourceSize = sourceSize;
+	header.numBuckets = numBuckets;
+	header.numEntries = entries.size();
+	header.numSegments = segments.size();
+	header.stringsSize = strings.size();
+
+	string result(reinterpret_cast<const char *>(&header), sizeof(header));
+	appendRaw(result, buckets);
+	appendRaw(result, entries);
+	appendRaw(result, segments);
+	result += strings;
+	return result;
 }
 
-string Translator::translate(const string &term,const char *replacestr,...) {
-	string result = term;
+bool Translator::attach(const char *data, size_t size,
+		int64_t sourceMtime, uint64_t sourceSize) {
+	static_assert(sizeof(Header) % sizeof(uint32_t) == 0,
+			"catalog sections must stay aligned");
+
+	if (size < sizeof(Header))
+		return false;
+	const Header *h = reinterpret_cast<const Header *>(data);
+	if (memcmp(h->magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0
+			|| h->version != CATALOG_VERSION
+			|| h->sourceMtime != sourceMtime
+			|| h->sourceSize != sourceSize
+			|| h->numBuckets == 0
+			|| (h->numBuckets & (h->numBuckets - 1)) != 0
+			|| h->numEntries >= h->numBuckets
+			|| size != sizeof(Header)
+				+ h->numBuckets * sizeof(uint32_t)
+				+ h->numEntries * sizeof(Entry)
+				+ h->numSegments * sizeof(Segment)
+				+ h->stringsSize)
+		return false;
+
+	this->data = data;
+	this->size = size;
+	header = h;
+	buckets = reinterpret_cast<const uint32_t *>(header + 1);
+	entries = reinterpret_cast<const Entry *>(buckets + header->numBuckets);
+	segments = reinterpret_cast<const Segment *>(entries + header->numEntries);
+	strings = reinterpret_cast<const char *>(segments + header->numSegments);
+	return true;
+}
+
+bool Translator::mapFile(const string &path,
+		int64_t sourceMtime, uint64_t sourceSize) {
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return false;
 
-	if (!_lang.empty()) {
-		unordered_map<string, string>::iterator i = translations.find(term);
-		if (i != translations.end()) {
-			result = i->second;
+	if (!attach(static_cast<const char *>(addr), st.st_size,
+			sourceMtime, sourceSize)) {
+		munmap(addr, st.st_size);
+		return false;
+	}
+	mapping = addr;
+	return true;
+}
+
+void Translator::setLang(const string &lang) {
+	unload();
+
+	string source = GMenu2X::getHome() + "/translations/" + lang;
+	if (!fileExists(source))
+		source = string(GMENU2X_SYSTEM_DIR "/translations/") + lang;
+	struct stat st;
+	if (stat(source.c_str(), &st) != 0)
+		return;
+
+	const string cacheDir = GMenu2X::getHome() + "/cache/translations";
+	const string cached = cacheDir + "/" + lang;
+	if (!mapFile(cached, st.st_mtime, st.st_size)) {
+		string compiled = compile(source, st.st_mtime, st.st_size);
+		if (compiled.empty())
+			return;
+
+		std::error_code ec;
+		compat::filesystem::create_directories(cacheDir, ec);
+		if (!writeStringToFile(cached, compiled)
+				|| !mapFile(cached, st.st_mtime, st.st_size)) {
+			WARNING("Unable to cache compiled translations in '%s'\n",
+					cached.c_str());
+			// Use the compiled catalog from memory instead.
+			buffer = move(compiled);
+			attach(buffer.data(), buffer.size(), st.st_mtime, st.st_size);
 		}
+	}
+	_lang = lang;
+}
+
+Translator::Id Translator::lookup(compat::string_view term) const {
+	if (!header)
+		return NO_ID;
 
-		else WARNING("Untranslated string: '%s'\n", term.c_str());
+	const uint32_t hash = hashTerm(term);
+	const uint32_t mask = header->numBuckets - 1;
+	for (uint32_t bucket = hash & mask; buckets[bucket] != 0;
+			bucket = (bucket + 1) & mask) {
+		const uint32_t index = buckets[bucket] - 1;
+		if (index >= header->numEntries)
+			break;
+		const Entry &entry = entries[index];
+		if (entry.hash == hash
+				&& compat::string_view(strings + entry.keyOffset,
+						entry.keyLength) == term)
+			return index;
 	}
+	return NO_ID;
+}
+
+Translator::Id Translator::id(compat::string_view term) {
+	const Id i = lookup(term);
+	if (i != NO_ID)
+		return i;
 
+	auto it = untranslatedIds.find(string(term));
+	if (it != untranslatedIds.end())
+		return it->second;
+	warnUntranslated(term);
+	const Id untranslatedId = UNTRANSLATED | untranslated.size();
+	untranslated.push_back(Untranslated { string(term), {} });
+	parseTemplate(compat::string_view(untranslated.back().term), 0,
+			untranslated.back().segments);
+	untranslatedIds.emplace(string(term), untranslatedId);
+	return untranslatedId;
+}
+
+compat::string_view Translator::get(Id id) const {
+	if (id & UNTRANSLATED)
+		return untranslated[id & ~UNTRANSLATED].term;
+	const Entry &entry = entries[id];
+	return compat::string_view(strings + entry.valueOffset, entry.valueLength);
+}
+
+compat::string_view Translator::get(compat::string_view term) const {
+	const Id i = lookup(term);
+	if (i != NO_ID)
+		return get(i);
+	warnUntranslated(term);
+	return term;
+}
+
+void Translator::warnUntranslated(compat::string_view term) const {
+	if (_lang.empty())
+		return;
+	// Only report each term once rather than on every frame it is drawn.
+	if (warned.insert(hashTerm(term)).second)
+		WARNING("Untranslated string: '%s'\n", string(term).c_str());
+}
+
+void Translator::segmentsOf(Id id, const Segment *&first,
+		const Segment *&last, const char *&text) const {
+	if (id & UNTRANSLATED) {
+		const Untranslated &term = untranslated[id & ~UNTRANSLATED];
+		first = term.segments.data();
+		last = first + term.segments.size();
+		text = term.term.data();
+	} else {
+		first = segments + entries[id].firstSegment;
+		last = first + entries[id].numSegments;
+		text = strings;
+	}
+}
+
+void Translator::render(string &out,
+		const Segment *first, const Segment *last, const char *text,
+		const char *const *params, size_t numParams) {
+	for (const Segment *segment = first; segment != last; ++segment) {
+		if (segment->param != 0 && segment->param <= numParams)
+			out += params[segment->param - 1];
+		else
+			out.append(text + segment->offset, segment->length);
+	}
+}
+
+string Translator::translate(const string &term,const char *replacestr,...) {
+	vector<const char *> params;
 	va_list arglist;
 	va_start(arglist, replacestr);
-	const char *param = replacestr;
-	int argnum = 1;
-	while (param!=NULL) {
-		string id = "";
-		stringstream ss; ss << argnum; ss >> id;
-		result = strreplace(result,"$"+id,param);
-
-		param = va_arg(arglist,const char*);
-		argnum++;
-	}
+	for (const char *param = replacestr; param != NULL;
+			param = va_arg(arglist, const char *))
+		params.push_back(param);
 	va_end(arglist);
 
+	const Id i = lookup(term);
+	if (i == NO_ID)
+		warnUntranslated(term);
+	if (params.empty())
+		return string(i == NO_ID ? compat::string_view(term) : get(i));
+
+	vector<Segment> parsed;
+	const Segment *first, *last;
+	const char *text;
+	if (i != NO_ID) {
+		segmentsOf(i, first, last, text);
+	} else {
+		parseTemplate(compat::string_view(term), 0, parsed);
+		first = parsed.data();
+		last = first + parsed.size();
+		text = term.data();
+	}
+
+	string result;
+	render(result, first, last, text, params.data(), params.size());
 	return result;
 }
 
+compat::string_view Translator::format(string &out, Id id,
+		const char *replacestr, ...) const {
+	// Labels that are repainted have few parameters; more are ignored.
+	const char *params[9];
+	size_t numParams = 0;
+	va_list arglist;
+	va_start(arglist, replacestr);
+	for (const char *param = replacestr; param != NULL && numParams < 9;
+			param = va_arg(arglist, const char *))
+		params[numParams++] = param;
+	va_end(arglist);
+
+	const Segment *first, *last;
+	const char *text;
+	segmentsOf(id, first, last, text);
+	out.clear();
+	render(out, first, last, text, params, numParams);
+	return out;
+}
+
 string Translator::operator[](const string &term) {
-	return translate(term);
+	return string(get(term));
 }
 
 string Translator::lang() {
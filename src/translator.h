@@ -21,29 +21,143 @@
 #ifndef TRANSLATOR_H
 #define TRANSLATOR_H
 
+#include "compat-string_view.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 /**
-Hash Map of translation strings.
+Catalog of translation strings.
+
+The text catalogs are compiled into a binary hash table, which is cached in
+the home directory and mapped into memory, so looking up a string neither
+parses nor allocates.
 
 	@author Massimiliano Torromeo <massimiliano.torromeo@gmail.com>
 */
 class Translator {
-private:
-	std::string _lang;
-	std::unordered_map<std::string, std::string> translations;
-
 public:
+	/**
+	 * Identifies a term, so that a label which is drawn every frame can be
+	 * looked up once. IDs are only valid until the next call to setLang().
+	 */
+	typedef std::uint32_t Id;
+
 	Translator(const std::string &lang="");
 	~Translator();
 
+	Translator(const Translator &) = delete;
+	Translator &operator=(const Translator &) = delete;
+
 	std::string lang();
 	void setLang(const std::string &lang);
 	bool exists(const std::string &term);
+
+	/**
+	 * Returns the translation of the given term, or the term itself if it
+	 * is not translated. The result is valid until the next call to
+	 * setLang() and as long as the term is.
+	 */
+	compat::string_view get(compat::string_view term) const;
+
+	/**
+	 * Returns the ID of the given term. Terms that are not translated get
+	 * an ID as well, so this is meant for fixed labels, not for arbitrary
+	 * text.
+	 */
+	Id id(compat::string_view term);
+
+	/**
+	 * Returns the translation of the term with the given ID, which is valid
+	 * until the next call to setLang().
+	 */
+	compat::string_view get(Id id) const;
+
+	/**
+	 * Renders the translation of the term with the given ID into `out`,
+	 * with "$1", "$2", ... replaced by the given NULL-terminated list of
+	 * parameters, and returns it. Reuses the memory of `out`, so repainting
+	 * a label does not allocate.
+	 */
+	compat::string_view format(std::string &out, Id id,
+			const char *replacestr = NULL, ...) const;
+
+	/**
+	 * Returns the translation of the given term with "$1", "$2", ...
+	 * replaced by the given NULL-terminated list of parameters.
+	 */
 	std::string translate(const std::string &term,
 			const char *replacestr = NULL, ...);
 	std::string operator[](const std::string &term);
+
+private:
+	static const Id NO_ID = 0xFFFFFFFF;
+	// Set in the IDs of terms that are not in the catalog.
+	static const Id UNTRANSLATED = 0x80000000;
+
+	struct Header;
+	struct Entry;
+	struct Segment;
+
+	// A term without translation that has been given an ID.
+	struct Untranslated {
+		std::string term;
+		std::vector<Segment> segments;
+	};
+
+	// Returns the index of the given term's catalog entry, or NO_ID.
+	Id lookup(compat::string_view term) const;
+	// Returns the preparsed translation of the term with the given ID.
+	void segmentsOf(Id id, const Segment *&first, const Segment *&last,
+			const char *&text) const;
+	static void render(std::string &out,
+			const Segment *first, const Segment *last, const char *text,
+			const char *const *params, std::size_t numParams);
+
+	/**
+	 * Compiles the text catalog at the given path into the binary format.
+	 * Returns an empty string if the file could not be read.
+	 */
+	static std::string compile(const std::string &path,
+			std::int64_t sourceMtime, std::uint64_t sourceSize);
+
+	/**
+	 * Uses the given compiled catalog if it is valid and was compiled from
+	 * a text catalog with the given modification time and size.
+	 */
+	bool attach(const char *data, std::size_t size,
+			std::int64_t sourceMtime, std::uint64_t sourceSize);
+	bool mapFile(const std::string &path,
+			std::int64_t sourceMtime, std::uint64_t sourceSize);
+	void unload();
+	void warnUntranslated(compat::string_view term) const;
+
+	std::string _lang;
+
+	// The compiled catalog, either mapped or read into `buffer`.
+	const char *data;
+	std::size_t size;
+	void *mapping;
+	std::string buffer;
+
+	const Header *header;
+	const std::uint32_t *buckets;
+	const Entry *entries;
+	const Segment *segments;
+	const char *strings;
+
+	// Hashes of the untranslated terms that have been reported already.
+	mutable std::unordered_set<std::uint32_t> warned;
+
+	// Untranslated terms by ID, without the UNTRANSLATED bit. A deque, so
+	// that the views returned by get() stay valid when terms are added.
+	std::deque<Untranslated> untranslated;
+	std::unordered_map<std::string, Id> untranslatedIds;
 };
 
 #endif // TRANSLATOR_H
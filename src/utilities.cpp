@@ -100,7 +100,7 @@ constexpr int writeOpenFlags =
 		O_CREAT | O_WRONLY | O_TRUNC;
 
 // Use C functions since STL doesn't seem to have any way of applying fsync().
-bool writeStringToFile(string const& filename, string const& data) {
+bool writeStringToFile(string const& filename, string const& data, bool sync) {
 	// Open temporary file.
 	string tempname = filename + '~';
 	int fd = open(tempname.c_str(), writeOpenFlags, S_IRUSR | S_IWUSR);
@@ -122,7 +122,7 @@ bool writeStringToFile(string const& filename, string const& data) {
 			remaining -= written;
 		}
 	}
-	if (ok) {
+	if (ok && sync) {
 		ok = fsync(fd) == 0;
 	}
 
@@ -54,9 +54,13 @@ std::string readFileAsString(std::string const& filename);
  * Writes the given string to a file.
  * The update is done atomically but not durably; if you need durability
  * when fsync() the parent directory afterwards.
+ * @param sync Whether to flush the data to disk before replacing the file.
+ *             Caches can skip it, as long as they check what they read:
+ *             after a crash the file may be incomplete.
  * @return True iff the file was written successfully.
  */
-bool writeStringToFile(std::string const& filename, std::string const& data);
+bool writeStringToFile(std::string const& filename, std::string const& data,
+		bool sync = true);
 
 /**
  * Tells the file system to commit the given directory to disk.
@@ -26,6 +26,7 @@
 #include "gmenu2x.h"
 #include "iconbutton.h"
 #include "surface.h"
+#include "thumbnail_cache.h"
 #include "utilities.h"
 
 #include <iostream>
@@ -73,6 +74,12 @@ bool WallpaperDialog::exec()
 	int fontheight = gmenu2x.font->getLineSpacing();
 	unsigned int nb_elements = height / fontheight;
 
+	const string title = gmenu2x.tr["Wallpaper selection"];
+	const string subTitle = gmenu2x.tr["Select a wallpaper from the list"];
+
+	unique_ptr<OffscreenSurface> preview;
+	int previewIndex = -1;
+
 	while (!close) {
 		OutputSurface& s = *gmenu2x.s;
 
@@ -82,14 +89,23 @@ bool WallpaperDialog::exec()
 			firstElement = selected;
 
 		//Wallpaper
-		gmenu2x.sc[((string)"skin:wallpapers/" + wallpapers[selected]).c_str()]->blit(s, 0, 0);
+		if (previewIndex != (int)selected && selected < wallpapers.size()) {
+			previewIndex = selected;
+			preview = ThumbnailCache::instance().Get(
+					gmenu2x.sc.getSkinFilePath("wallpapers/" + wallpapers[selected]),
+					gmenu2x.width(), gmenu2x.height());
+			if (preview)
+				preview->convertToDisplayFormat();
+		}
+		if (preview)
+			preview->blit(s, 0, 0);
 
 		gmenu2x.drawTopBar(s);
 		gmenu2x.drawBottomBar(s);
 
 		drawTitleIcon(s, "icons/wallpaper.png", true);
-		writeTitle(s, gmenu2x.tr["Wallpaper selection"]);
-		writeSubTitle(s, gmenu2x.tr["Select a wallpaper from the list"]);
+		writeTitle(s, title);
+		writeSubTitle(s, subTitle);
 
 		buttonbox.paint(s, 5, gmenu2x.height() - 1);
 
@@ -147,9 +163,5 @@ bool WallpaperDialog::exec()
         }
 	}
 
-	for (size_t i=0; i<wallpapers.size(); i++) {
-	  gmenu2x.sc.del("skin:wallpapers/" + wallpapers[i]);
-	}
-
 	return result;
 }
@@ -0,0 +1,50 @@
+#include "wrapped_text_cache.h"
+
+#include <functional>
+#include <utility>
+
+#include "font_stack.h"
+#include "split_by_char.h"
+#include "surface.h"
+#include "word_wrap.h"
+
+namespace {
+
+// Dialogs only ever show a handful of titles, but setting descriptions and
+// file names can add up over a session, so start over past this many.
+constexpr std::size_t kMaxLayouts = 64;
+
+}  // namespace
+
+std::size_t WrappedTextCache::KeyHash::operator()(const Key &key) const {
+	return std::hash<std::string>()(key.text) ^
+	       std::hash<const FontStack *>()(key.font) ^
+	       (std::hash<int>()(key.width) << 1);
+}
+
+void WrappedTextCache::Layout::blit(Surface &s, int x, int y) const {
+	for (const auto &line : lines) {
+		// Rendered text has a 1 pixel outline on every side.
+		if (line.surface) line.surface->blit(s, x - 1, y + line.y - 1);
+	}
+}
+
+const WrappedTextCache::Layout &WrappedTextCache::Get(const FontStack &font,
+                                                      const std::string &text,
+                                                      int width) {
+	Key key{&font, width, text};
+	auto it = layouts_.find(key);
+	if (it != layouts_.end()) return it->second;
+
+	if (layouts_.size() >= kMaxLayouts) layouts_.clear();
+
+	const std::string wrapped = width > 0 ? wordWrap(font, text, width) : text;
+	Layout layout;
+	layout.height = 0;
+	for (compat::string_view line : SplitByChar(wrapped, '\n')) {
+		layout.lines.push_back(Line{
+		    line.empty() ? nullptr : font.render(line), layout.height});
+		layout.height += font.getTextHeight(line);
+	}
+	return layouts_.emplace(std::move(key), std::move(layout)).first->second;
+}
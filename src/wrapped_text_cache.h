@@ -0,0 +1,59 @@
+#ifndef _WRAPPED_TEXT_CACHE_H_
+#define _WRAPPED_TEXT_CACHE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class FontStack;
+class OffscreenSurface;
+class Surface;
+
+// Word-wrapped and pre-rendered text, keyed by text, width and font.
+// Lets dialogs redraw titles every frame without wrapping and measuring the
+// text again.
+class WrappedTextCache {
+ public:
+	struct Line {
+		// nullptr for empty lines.
+		std::unique_ptr<OffscreenSurface> surface;
+		int y;  // relative to the top of the text
+	};
+
+	struct Layout {
+		std::vector<Line> lines;
+		int height;
+
+		// Draws the text with its top-left at (x, y), like FontStack::write.
+		void blit(Surface &s, int x, int y) const;
+	};
+
+	// Returns the layout of `text` wrapped to `width` pixels, or not wrapped
+	// at all if `width` is 0. The result is valid until the next call.
+	const Layout &Get(const FontStack &font, const std::string &text,
+	                  int width);
+
+	// Must be called when the fonts of a FontStack change.
+	void Clear() { layouts_.clear(); }
+
+ private:
+	struct Key {
+		const FontStack *font;
+		int width;
+		std::string text;
+		bool operator==(const Key &other) const {
+			return font == other.font && width == other.width &&
+			       text == other.text;
+		}
+	};
+
+	struct KeyHash {
+		std::size_t operator()(const Key &key) const;
+	};
+
+	std::unordered_map<Key, Layout, KeyHash> layouts_;
+};
+
+#endif  // _WRAPPED_TEXT_CACHE_H_
@@ -0,0 +1,72 @@
+// Creates gmenu2x links for the applications in directories of executables.
+// See src/app_importer.h for what is imported.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+#include "app_importer.h"
+#include "buildopts.h"
+
+namespace {
+
+void Usage(const char *argv0) {
+	std::fprintf(stderr,
+	    "Usage: %s [-n] [-s SECTIONS] DIR...\n"
+	    "\n"
+	    "Adds a link for every application in the DIRs that has none yet,\n"
+	    "neither in SECTIONS nor in the sections installed with gmenu2x.\n"
+	    "\n"
+	    "  -n           Only list the applications that would be imported.\n"
+	    "  -s SECTIONS  The sections directory to write the links to.\n"
+	    "               Defaults to $HOME/.gmenu2x/sections.\n",
+	    argv0);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	bool dry_run = false;
+	std::string sections_dir;
+	int opt;
+	while ((opt = getopt(argc, argv, "ns:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			dry_run = true;
+			break;
+		case 's':
+			sections_dir = optarg;
+			break;
+		default:
+			Usage(argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (optind == argc) {
+		Usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (sections_dir.empty()) {
+		const char *home = std::getenv("HOME");
+		if (!home) {
+			std::fprintf(stderr, "HOME is not set; use -s\n");
+			return EXIT_FAILURE;
+		}
+		sections_dir = std::string(home) + "/.gmenu2x/sections";
+	}
+
+	AppImporter importer(sections_dir, {GMENU2X_SYSTEM_DIR "/sections"});
+	bool ok = true;
+	for (int i = optind; i < argc; ++i) ok &= importer.Scan(argv[i]);
+
+	if (!dry_run) ok &= importer.Write();
+	for (const AppImporter::App &app : importer.apps()) {
+		if (dry_run || !app.file.empty()) {
+			std::printf("%s: %s (%s)\n", app.section.c_str(), app.title.c_str(),
+			            app.exec.c_str());
+		}
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+// Compiles a TrueType font into the bitmap font format that gmenu2x maps
+// directly at startup. See src/bitmap_font.h.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bitmap_font.h"
+#include "font_spec.h"
+
+namespace {
+
+void Usage(const char *argv0) {
+	std::fprintf(stderr,
+	    "Usage: %s [-r RANGES] FONT SIZE [OUTPUT]\n"
+	    "\n"
+	    "Rasterizes FONT at SIZE points. OUTPUT defaults to FONT.SIZE.bfont,\n"
+	    "which is where gmenu2x looks for it.\n"
+	    "\n"
+	    "  -r RANGES  Only include the given code points, as a comma-separated\n"
+	    "             list of hexadecimal values or ranges, e.g. 20-7e,a0-17f.\n"
+	    "             Other code points are drawn from FONT at runtime.\n",
+	    argv0);
+}
+
+bool ParseCodePoint(const char *str, char **end, std::uint16_t *result) {
+	const unsigned long value = std::strtoul(str, end, 16);
+	if (*end == str || value > 0xFFFF) return false;
+	*result = value;
+	return true;
+}
+
+bool ParseRanges(const char *str,
+                 std::vector<std::pair<std::uint16_t, std::uint16_t>> *ranges) {
+	char *end;
+	while (*str != '\0') {
+		std::pair<std::uint16_t, std::uint16_t> range;
+		if (!ParseCodePoint(str, &end, &range.first)) return false;
+		range.second = range.first;
+		if (*end == '-' && !ParseCodePoint(end + 1, &end, &range.second))
+			return false;
+		if (range.second < range.first) return false;
+		ranges->push_back(range);
+		if (*end == ',') ++end;
+		else if (*end != '\0') return false;
+		str = end;
+	}
+	return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+	std::vector<std::pair<std::uint16_t, std::uint16_t>> ranges;
+	int opt;
+	while ((opt = getopt(argc, argv, "r:h")) != -1) {
+		switch (opt) {
+		case 'r':
+			if (!ParseRanges(optarg, &ranges)) {
+				std::fprintf(stderr, "Invalid code point ranges: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			Usage(argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (argc - optind < 2 || argc - optind > 3) {
+		Usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	char *end;
+	const unsigned long size = std::strtoul(argv[optind + 1], &end, 10);
+	if (*end != '\0' || size == 0) {
+		std::fprintf(stderr, "Invalid font size: %s\n", argv[optind + 1]);
+		return EXIT_FAILURE;
+	}
+	const FontSpec spec{argv[optind], static_cast<unsigned int>(size)};
+	const std::string out_path =
+	    argc - optind == 3 ? argv[optind + 2] : BitmapFont::PathFor(spec);
+
+	return BitmapFont::Compile(spec, out_path, ranges) ? EXIT_SUCCESS
+	                                                   : EXIT_FAILURE;
+}